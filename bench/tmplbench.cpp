@@ -0,0 +1,288 @@
+/// \file tmplbench.cpp
+/// ģܲ
+/// ÷: tmplbench [-d ģĿ¼] [-t ÿ] [-c ] [-o ļ]
+/// ģĿ¼ĬΪbench,ģΪĿ¼е*.tmplļ,
+/// ÿֱhtml()print()ļprint()/dev/null,
+/// ÿһJSON: ÿÿֽÿڴ
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <iostream>
+#include <sys/time.h>
+#include <unistd.h>
+#include "waTemplate.h"
+#include "waJson.h"
+
+using namespace webapp;
+
+////////////////////////////////////////////////////////////////////////////
+// allocation counter
+
+static size_t allocs = 0;
+
+#if __cplusplus >= 201103L
+#define BENCH_THROW
+#define BENCH_NOTHROW noexcept
+#else
+#define BENCH_THROW throw(std::bad_alloc)
+#define BENCH_NOTHROW throw()
+#endif
+
+void* operator new( size_t size ) BENCH_THROW {
+	++allocs;
+	void *p = malloc( size>0 ? size : 1 );
+	if ( p == 0 )
+		throw std::bad_alloc();
+	return p;
+}
+void* operator new[]( size_t size ) BENCH_THROW {
+	return operator new( size );
+}
+void operator delete( void *p ) BENCH_NOTHROW {
+	free( p );
+}
+void operator delete[]( void *p ) BENCH_NOTHROW {
+	free( p );
+}
+
+////////////////////////////////////////////////////////////////////////////
+// test data
+
+/// ־
+/// м,ģ
+class LogGenerator : public TemplateGenerator {
+	public:
+
+	LogGenerator( const size_t rows ):
+	_rows(rows)
+	{};
+
+	virtual size_t cols() const {
+		return 3;
+	}
+	virtual string field( const size_t col ) const {
+		static const char* fields[] = { "seq", "level", "message" };
+		return fields[col];
+	}
+	virtual bool fetch( const size_t row ) {
+		if ( row >= _rows )
+			return false;
+		_seq = itos( row+1 );
+		_msg = "request " + _seq + " finished in " + itos( row%97 ) + "ms";
+		_level = ( row%50==0 ) ? "ERROR" : ( row%7==0 ) ? "WARN" : "INFO";
+		return true;
+	}
+	virtual const char* cell( const size_t, const size_t col, size_t &len ) const {
+		const string &val = ( col==0 ) ? _seq : ( col==1 ) ? _level : _msg;
+		len = val.length();
+		return val.data();
+	}
+	virtual size_t rows() const {
+		return _rows;
+	}
+
+	private:
+
+	size_t _rows;
+	string _seq;
+	string _level;
+	string _msg;
+};
+
+/// 
+/// \param tmpl ģ
+static void setup_deep_if( Template &tmpl ) {
+	tmpl.set( "flag", "1" );
+	tmpl.set( "mode", 2L );
+	tmpl.def_loop( "rows", "name", "l0", "l1", "l2", "l3", "l4", "l5", "l6", "l7", NULL );
+	vector<string> row( 9 );
+	for ( int i=0; i<200; ++i ) {
+		row[0] = "rule" + itos( i );
+		for ( int l=0; l<8; ++l )
+			row[l+1] = itos( (i>>l)%3==0 ? 1 : (i+l)%4 );
+		tmpl.append_row( "rows", row );
+	}
+}
+
+/// ѭ
+/// \param tmpl ģ
+static void setup_big_loop( Template &tmpl ) {
+	const int rows = 5000;
+	tmpl.def_loop( "report", "id", "name", "email", "amount", "status", "date", NULL );
+	tmpl.reserve_rows( "report", rows, rows*64 );
+	for ( int i=0; i<rows; ++i ) {
+		tmpl.append_format( "report", "%d,user%d,user%d@example.com,%d.%02d,%d,2026-10-%02d",
+			100000+i, i, i, i*37%10000, i%100, i%5!=0, i%28+1 );
+	}
+}
+
+/// 
+/// \param tmpl ģ
+static void setup_many_vars( Template &tmpl ) {
+	tmpl.set( "action", "/cgi-bin/save.cgi" );
+	for ( int i=0; i<200; ++i ) {
+		tmpl.set( "label"+itos(i), "Field " + itos(i) );
+		if ( i%3 == 0 )
+			tmpl.set( "v"+itos(i), static_cast<long>(i*1000) );
+		else
+			tmpl.set( "v"+itos(i), "value of field " + itos(i) );
+		if ( i%17 == 0 )
+			tmpl.set( "err"+itos(i), "invalid value" );
+	}
+}
+
+/// 
+/// \param tmpl ģ
+static void setup_gbk_text( Template &tmpl ) {
+	tmpl.set( "title", "ģܲԱ" );
+	tmpl.set( "author", "" );
+	tmpl.set( "date", "2026-10-19" );
+	tmpl.set( "hits", 12345L );
+	tmpl.set( "site", "ʾվ" );
+	tmpl.set( "year", 2026L );
+	const int comments = 100;
+	tmpl.set( "comments", comments );
+	tmpl.def_loop( "para", "text", NULL );
+	for ( int i=0; i<50; ++i )
+		tmpl.append_row( "para", ("" + itos(i+1) + "Σ").c_str(), NULL );
+	tmpl.def_loop( "comment", "user", "text", "top", NULL );
+	for ( int i=0; i<comments; ++i ) {
+		tmpl.append_row( "comment", ("û"+itos(i)).c_str(), "ͬ¥ϵĹ۵㣬ݺвοֵ",
+			i<3 ? "1" : "0", NULL );
+	}
+}
+
+/// ѭ
+/// \param tmpl ģ
+static void setup_generator( Template &tmpl ) {
+	static LogGenerator generator( 2000 );
+	tmpl.bind_loop( "log", generator );
+}
+
+/// 
+typedef struct {
+	const char *name;					// ,ģļΪ<name>.tmpl
+	void (*setup)( Template &tmpl );	// ģ
+} bench_case;
+
+static const bench_case cases[] = {
+	{ "deep_if", setup_deep_if },
+	{ "big_loop", setup_big_loop },
+	{ "many_vars", setup_many_vars },
+	{ "gbk_text", setup_gbk_text },
+	{ "generator", setup_generator },
+	{ NULL, NULL }
+};
+
+////////////////////////////////////////////////////////////////////////////
+// benchmark
+
+/// ǰʱ
+/// \return ǰʱ,λΪ΢
+static double now() {
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec*1e6 + tv.tv_usec;
+}
+
+/// һ
+/// \param tmpl ģ
+/// \param target ,htmlfilenull
+/// \param file ļ
+static void render( Template &tmpl, const string &target, const string &file ) {
+	if ( target == "html" )
+		tmpl.html();
+	else if ( target == "file" )
+		tmpl.print( file );
+	else
+		tmpl.print( "/dev/null" );
+}
+
+/// һ
+/// \param name 
+/// \param target 
+/// \param tmpl ģ
+/// \param bytes ÿֽ
+/// \param seconds ʱ,λΪ
+/// \param file ļ
+static void bench( const string &name, const string &target, Template &tmpl,
+	const size_t bytes, const double seconds, const string &file )
+{
+	// warm up
+	render( tmpl, target, file );
+
+	size_t renders = 0;
+	size_t start_allocs = allocs;
+	double start = now();
+	double elapsed;
+	do {
+		render( tmpl, target, file );
+		++renders;
+		elapsed = now() - start;
+	} while ( elapsed < seconds*1e6 );
+	size_t used_allocs = allocs - start_allocs;
+
+	Json json( cout );
+	json.begin_object()
+		.member( "case", name )
+		.member( "target", target )
+		.member( "renders", renders )
+		.member( "bytes", bytes )
+		.member( "ns_per_render", elapsed*1000/renders )
+		.member( "bytes_per_sec", bytes*renders/(elapsed/1e6) )
+		.member( "allocs_per_render", static_cast<double>(used_allocs)/renders )
+		.end_object();
+	json.flush();
+	cout << endl;
+}
+
+int main( int argc, char **argv ) {
+	string dir = "bench";
+	string only;
+	string file = "/tmp/tmplbench." + itos( getpid() ) + ".html";
+	double seconds = 1;
+
+	int opt;
+	while ( (opt=getopt(argc,argv,"d:t:c:o:")) != -1 ) {
+		switch ( opt ) {
+			case 'd': dir = optarg; break;
+			case 't': seconds = atof( optarg ); break;
+			case 'c': only = optarg; break;
+			case 'o': file = optarg; break;
+			default:
+				cerr << "Usage: " << argv[0] << " [-d tmpl_dir] [-t seconds] [-c case] [-o output_file]" << endl;
+				return 1;
+		}
+	}
+
+	static const char* targets[] = { "html", "file", "null", NULL };
+	for ( int i=0; cases[i].name!=NULL; ++i ) {
+		if ( only!="" && only!=cases[i].name )
+			continue;
+
+		Template tmpl;
+		if ( !tmpl.load(dir+"/"+cases[i].name+".tmpl") ) {
+			cerr << "Error: Can't open file " << dir << "/" << cases[i].name << ".tmpl" << endl;
+			return 1;
+		}
+		const multimap<int,string> &errors = tmpl.compiled()->errors();
+		if ( !errors.empty() ) {
+			for ( multimap<int,string>::const_iterator e=errors.begin(); e!=errors.end(); ++e ) {
+				cerr << dir << "/" << cases[i].name << ".tmpl:" << e->first+1 << ": "
+					<< e->second << endl;
+			}
+			return 1;
+		}
+		cases[i].setup( tmpl );
+
+		// html() ends with '\0'
+		size_t bytes = tmpl.html().length() - 1;
+		for ( int t=0; targets[t]!=NULL; ++t )
+			bench( cases[i].name, targets[t], tmpl, bytes, seconds, file );
+	}
+
+	unlink( file.c_str() );
+	return 0;
+}
@@ -0,0 +1,63 @@
+/// \file tmpl2cpp.cpp
+/// ģɹ,HTMLģļתΪC++ͷļ
+/// ÷: tmpl2cpp ģļ [namespace] [ļ]
+/// ɵͷļģݽṹdatarender()html(),
+/// ʱҪwebapplibͷļĿ¼,webapplib
+
+#include <iostream>
+#include <fstream>
+#include "waTemplate.h"
+
+using namespace webapp;
+
+int main( int argc, char **argv ) {
+	if ( argc < 2 ) {
+		cerr << "Usage: " << argv[0] << " tmpl_file [name] [output_file]" << endl;
+		return 1;
+	}
+
+	// template file and name
+	string tmpl_file = argv[1];
+	string name = ( argc>2 ) ? argv[2] : "";
+	if ( name == "" ) {
+		size_t pos = tmpl_file.rfind( "/" );
+		name = ( pos!=tmpl_file.npos ) ? tmpl_file.substr(pos+1) : tmpl_file;
+		pos = name.find( "." );
+		if ( pos != name.npos )
+			name.erase( pos );
+	}
+
+	// compile
+	String tmpl;
+	if ( !tmpl.load_file(tmpl_file) ) {
+		cerr << "Error: Can't open file " << tmpl_file << endl;
+		return 1;
+	}
+	size_t pos = tmpl_file.rfind( "/" );
+	string tmpl_dir = ( pos==tmpl_file.npos ) ? "." : ( pos==0 ) ? "/" : tmpl_file.substr( 0, pos );
+	CompiledTemplate code( tmpl, tmpl_dir );
+
+	const multimap<int,string> &errors = code.errors();
+	for ( multimap<int,string>::const_iterator i=errors.begin(); i!=errors.end(); ++i )
+		cerr << tmpl_file << ":" << i->first+1 << ": " << i->second << endl;
+
+	// generate
+	TemplateCodegen codegen( code );
+	bool res;
+	if ( argc > 3 ) {
+		ofstream output( argv[3] );
+		if ( !output ) {
+			cerr << "Error: Can't write file " << argv[3] << endl;
+			return 1;
+		}
+		res = codegen.generate( output, name, tmpl_file );
+	} else {
+		res = codegen.generate( cout, name, tmpl_file );
+	}
+
+	const multimap<int,string> &genlog = codegen.errors();
+	for ( multimap<int,string>::const_iterator i=genlog.begin(); i!=genlog.end(); ++i )
+		cerr << tmpl_file << ":" << i->first+1 << ": " << i->second << endl;
+
+	return res ? 0 : 1;
+}
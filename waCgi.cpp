@@ -46,7 +46,7 @@ string get_env( const string &envname ) {
 
 /// 캯
 /// ȡCGI
-/// \param formdata_maxsize "multipart/form-data"ʽPOSTʱFORMϴݴС,
+/// \param formdata_maxsize "multipart/form-data"ǱͷʽPOSTʱϴݴС,
 /// ֱضϲ,λΪbyte,ĬΪ0ݴС
 Cgi::Cgi( const size_t formdata_maxsize ) {
 	// get envionment variable REQUEST_METHOD
@@ -114,6 +114,24 @@ Cgi::Cgi( const size_t formdata_maxsize ) {
 			
 			// parse stdin
 			this->parse_multipart( content_type, buf );
+
+		} else {
+			// other content type, keep raw body
+			int content_length = atoi( (get_env("CONTENT_LENGTH")).c_str() );
+			if ( formdata_maxsize>0 && static_cast<size_t>(content_length)>formdata_maxsize ) {
+				content_length = formdata_maxsize;
+				_trunc = true;
+			}
+			if ( content_length > 0 ) {
+				// read in chunks, CONTENT_LENGTH may be larger than actual body
+				char chunk[4096];
+				size_t left = content_length;
+				while ( left>0 && cin ) {
+					cin.read( chunk, min(left,sizeof(chunk)) );
+					_body.append( chunk, cin.gcount() );
+					left -= cin.gcount();
+				}
+			}
 		}
 	}
 }
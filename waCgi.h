@@ -1,12 +1,13 @@
 /// \file waCgi.h
 /// webapp::Cgi,webapp::Cookieͷļ
-///  webapp::String, webapp::Encode
+///  webapp::String, webapp::Encode, webapp::Json
 
 #ifndef _WEBAPPLIB_CGI_H_
 #define _WEBAPPLIB_CGI_H_ 
 
 #include <string>
 #include <map>
+#include "waJson.h"
 
 using namespace std;
 
@@ -56,6 +57,20 @@ class Cgi {
 	inline CgiList dump() const {
 		return _cgi;
 	}
+
+	/// ԭʼPOST
+	/// ֻContent-TypeǱ(application/json)POST
+	/// \return ԭʼPOST
+	inline const string& body() const {
+		return _body;
+	}
+
+	/// POSTݵJSON
+	/// ,POST,ֵCgiЧڼЧ
+	/// \return JsonValue,POSTΪʱΪЧֵ
+	inline JsonValue json() const {
+		return JsonValue( _body );
+	}
 	
 	////////////////////////////////////////////////////////////////////////////
 	private:
@@ -70,6 +85,7 @@ class Cgi {
 	void parse_multipart( const string &content_type, const string &buf );
 
 	map<string,string> _cgi;
+	string _body;
 	String _method;
 	bool _trunc;
 };
@@ -2,10 +2,16 @@
 /// HTTPͻʵļ
 
 #include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <algorithm>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -19,6 +25,82 @@ namespace webapp {
 
 /// \defgroup waHttpClient waHttpClientȫֺ
 
+/// ӷ
+/// \param server IP
+/// \param port ˿
+/// \param nonblock Ƿʹ÷socket,Ϊtrueʱȴ,ĬΪfalse
+/// \return ɹsocket,socketʧܷ-1,޷ӷ-2
+static int tcp_connect( const string &server, const int port, const bool nonblock = false ) {
+	struct sockaddr_in sin;
+	memset( &sin, 0, sizeof(sin) );
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons( port );
+	sin.sin_addr.s_addr = inet_addr( server.c_str() );
+
+	int fd;
+	if ( (fd=socket(AF_INET,SOCK_STREAM,0)) < 0 )
+		return -1;
+	if ( nonblock )
+		fcntl( fd, F_SETFL, fcntl(fd,F_GETFL)|O_NONBLOCK );
+	if ( connect(fd,(struct sockaddr*)&sin,sizeof(sin))<0 && !(nonblock&&errno==EINPROGRESS) ) {
+		close( fd );
+		return -2;
+	}
+	return fd;
+}
+
+/// ǰʱ
+/// \return ǰʱ,λΪ
+static long long now_msec() {
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return static_cast<long long>( tv.tv_sec )*1000 + tv.tv_usec/1000;
+}
+
+/// ÿνݵ󳤶
+static const size_t HTTP_RECV_SIZE = 65536;
+/// ͷ󳤶
+static const size_t HTTP_HEAD_MAX = 262144;
+/// Content-LengthԤȷĻ󳤶,ʱ
+static const size_t HTTP_RESERVE_MAX = HTTP_RECV_SIZE*16;
+/// ȴʱļ,λΪ
+static const int HTTP_WAIT_POLL = 10;
+
+/// 
+static bool discard_output( const char*, const size_t, void* ) {
+	return true;
+}
+
+/// ĳ
+/// Content-Lengthchunk,ܷšհ׼ֵ
+/// \param str ַ
+/// \param len ַ
+/// \param hex ǷΪʮ
+/// \param value ֵ
+/// \return ѷַ,ûֵֻʱ0
+static size_t parse_length( const char *str, const size_t len, const bool hex, size_t &value ) {
+	const size_t base = hex ? 16 : 10;
+	size_t i;
+	value = 0;
+	for ( i=0; i<len; ++i ) {
+		size_t digit;
+		if ( str[i]>='0' && str[i]<='9' )
+			digit = str[i] - '0';
+		else if ( hex && str[i]>='a' && str[i]<='f' )
+			digit = str[i] - 'a' + 10;
+		else if ( hex && str[i]>='A' && str[i]<='F' )
+			digit = str[i] - 'A' + 10;
+		else
+			break;
+
+		// string::npos means unknown length
+		if ( value > (string::npos-1-digit)/base )
+			return 0;
+		value = value*base + digit;
+	}
+	return i;
+}
+
 /// \ingroup waHttpClient
 /// \fn int tcp_request( const string &server, const int port, const string &request, string &response, const int timeout )
 /// TCPȡûӦ
@@ -33,25 +115,15 @@ namespace webapp {
 /// \retval 3 ʧ
 /// \retval 4 öʱʧܻӳʱ
 /// \retval 10 δ֪
+/// Ӧݰԭʼֽڱ,԰'\0',
+/// յӦHeaderContent-LengthԤӦݿռ
 int tcp_request( const string &server, const int port, const string &request,
 	string &response, const int timeout ) 
 {
-	// init
-	struct sockaddr_in sin;	 
-	sin.sin_family = AF_INET;
-	sin.sin_port = htons( port );
-	sin.sin_addr.s_addr = inet_addr( server.c_str() );
-	
-	// create socket
-	int fd;
-	if ( (fd=socket(AF_INET,SOCK_STREAM,0)) < 0 )
-		return 1;
-
 	// connect
-	if ( connect(fd,(struct sockaddr*)&sin,sizeof(sin)) < 0 ) {
-		close( fd );
-		return 2;
-	}
+	int fd = tcp_connect( server, port );
+	if ( fd < 0 )
+		return -fd;
 
 	// send request
 	if ( send(fd,request.c_str(),request.length(),0) < 0 ) {
@@ -77,13 +149,25 @@ int tcp_request( const string &server, const int port, const string &request,
 
 	if ( ( timeout>0 && FD_ISSET(fd,&fds) ) || timeout<=0 ) {
 		// recv response
-		int readed = 0;
-		int buflen = 1024;
-		char buff[1024];
+		vector<char> buff( HTTP_RECV_SIZE );
+		HttpResponseParser parser;
+		parser.reset( request.compare(0,5,"HEAD ")==0 );
+		parser.set_output( discard_output );
+		bool framed = false;
+		ssize_t readed;
 		
-		while ( (readed=recv(fd,buff,buflen-1,0)) > 0 ) {
-			buff[readed] = '\0';
-			response += buff;
+		while ( (readed=recv(fd,&buff[0],buff.size(),0)) > 0 ) {
+			response.append( &buff[0], readed );
+
+			// reserve for Content-Length, larger response grows as received
+			if ( !framed ) {
+				parser.parse( &buff[0], readed );
+				if ( parser.header_done() ) {
+					framed = true;
+					if ( parser.content_length() != string::npos )
+						response.reserve( parser.head().length()+min(parser.content_length(),HTTP_RESERVE_MAX) );
+				}
+			}
 		}
 
 		close( fd );
@@ -97,14 +181,27 @@ int tcp_request( const string &server, const int port, const string &request,
 /// \ingroup waHttpClient
 /// \fn string gethost_byname( const string &domain )
 /// ݷȡIP
+/// ʹgetaddrinfo()IPv4ַ,ڶ߳ͬʱ,ʹû,
+/// ҪʱʹDnsCache::resolve()
 /// \param domain "HTTP:://"ͷκ'/'ַ
 /// \return ִгɹطIP,򷵻ؿַ
 string gethost_byname( const string &domain ) {
 	string ip;
 	if ( domain != "" ) {
-		struct hostent *he = gethostbyname( domain.c_str() );
-		if ( he!=NULL && he->h_addr!=NULL )
-			ip = inet_ntoa( *((struct in_addr*)he->h_addr) );
+		struct addrinfo hints;
+		struct addrinfo *res = NULL;
+		memset( &hints, 0, sizeof(hints) );
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+
+		if ( getaddrinfo(domain.c_str(),NULL,&hints,&res)==0 && res!=NULL ) {
+			char buf[INET_ADDRSTRLEN];
+			struct sockaddr_in *addr = reinterpret_cast<struct sockaddr_in*>( res->ai_addr );
+			if ( inet_ntop(AF_INET,&addr->sin_addr,buf,sizeof(buf)) != NULL )
+				ip = buf;
+		}
+		if ( res != NULL )
+			freeaddrinfo( res );
 	}
 
 	return ip;
@@ -125,6 +222,861 @@ bool isip( const string &ipstr ) {
 		return false;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+/// ؽ̹
+/// HttpClientʹøû
+/// \return 
+DnsCache& DnsCache::instance() {
+	static DnsCache cache;
+	return cache;
+}
+
+/// 캯
+/// \param ttl ʱ,λΪ,ĬΪ300
+/// \param negative_ttl ʧܽʱ,λΪ,ĬΪ10
+DnsCache::DnsCache( const int ttl, const int negative_ttl ):
+_running(false), _stop(false), _interval(0), _ttl(ttl), _negative_ttl(negative_ttl)
+{
+	pthread_mutex_init( &_lock, NULL );
+	pthread_cond_init( &_wake, NULL );
+}
+
+/// 
+DnsCache::~DnsCache() {
+	this->stop_refresh();
+	pthread_cond_destroy( &_wake );
+	pthread_mutex_destroy( &_lock );
+}
+
+/// ûʱ
+/// ֻӰ֮Ľ
+/// \param ttl ʱ,λΪ,Ϊ0ʱ
+/// \param negative_ttl ʧܽʱ,λΪ,ĬΪ10,Ϊ0ʱ
+void DnsCache::set_ttl( const int ttl, const int negative_ttl ) {
+	pthread_mutex_lock( &_lock );
+	_ttl = ttl;
+	_negative_ttl = negative_ttl;
+	pthread_mutex_unlock( &_lock );
+}
+
+/// 
+/// ûлѹʱgethost_byname(),
+/// ʱ,߳ͬʱͬһʱظ
+/// \param domain ,ΪIPʱֱӷ
+/// \return ִгɹIP,򷵻ؿַ
+string DnsCache::resolve( const string &domain ) {
+	if ( domain=="" || isip(domain) )
+		return domain;
+
+	String key = domain;
+	key.lower();
+	time_t now = time( 0 );
+
+	pthread_mutex_lock( &_lock );
+	map<string,dns_entry>::iterator i = _cache.find( key );
+	if ( i!=_cache.end() && (i->second.expire==0 || i->second.expire>now) ) {
+		i->second.used = now;
+		string ip = i->second.ip;
+		pthread_mutex_unlock( &_lock );
+		return ip;
+	}
+	pthread_mutex_unlock( &_lock );
+
+	// resolve without lock
+	string ip = gethost_byname( domain );
+
+	pthread_mutex_lock( &_lock );
+	int ttl = ( ip!="" ) ? _ttl : _negative_ttl;
+	if ( ttl > 0 ) {
+		dns_entry &entry = _cache[key];
+		if ( entry.expire!=0 || entry.ip=="" ) {
+			entry.ip = ip;
+			entry.expire = now + ttl;
+		}
+		entry.used = now;
+	}
+	pthread_mutex_unlock( &_lock );
+	return ip;
+}
+
+/// ý
+/// \param domain 
+/// \param ip IP
+/// \param ttl ʱ,λΪ,ĬΪ0
+void DnsCache::set( const string &domain, const string &ip, const int ttl ) {
+	if ( domain=="" || !isip(ip) )
+		return;
+
+	String key = domain;
+	key.lower();
+	time_t now = time( 0 );
+
+	pthread_mutex_lock( &_lock );
+	dns_entry &entry = _cache[key];
+	entry.ip = ip;
+	entry.expire = ( ttl>0 ) ? now+ttl : 0;
+	entry.used = now;
+	pthread_mutex_unlock( &_lock );
+}
+
+/// hostsļ
+/// ļʽͬ/etc/hosts,ÿΪIPһ,'#'֮Ϊע,
+/// ֻIPv4ַ,Ľ
+/// \param file ļ·,ĬΪ"/etc/hosts"
+/// \return ,ļܶȡʱ0
+size_t DnsCache::load_hosts( const string &file ) {
+	String hosts;
+	if ( !hosts.load_file(file) )
+		return 0;
+
+	size_t count = 0;
+	vector<String> lines = hosts.split( "\n" );
+	for ( size_t i=0; i<lines.size(); ++i ) {
+		String line = lines[i];
+		size_t pos = line.find( "#" );
+		if ( pos != line.npos )
+			line.erase( pos );
+		line.replace_all( "\t", " " );
+		line.trim();
+
+		vector<String> fields = line.split( " " );
+		if ( fields.size()<2 || !isip(fields[0]) )
+			continue;
+		for ( size_t j=1; j<fields.size(); ++j ) {
+			this->set( fields[j], fields[0] );
+			++count;
+		}
+	}
+	return count;
+}
+
+/// ɾ
+/// \param domain 
+void DnsCache::remove( const string &domain ) {
+	String key = domain;
+	key.lower();
+	pthread_mutex_lock( &_lock );
+	_cache.erase( key );
+	pthread_mutex_unlock( &_lock );
+}
+
+/// ջ
+/// hostsļ뼰set()õĽ
+void DnsCache::clear() {
+	pthread_mutex_lock( &_lock );
+	_cache.clear();
+	pthread_mutex_unlock( &_lock );
+}
+
+/// ػ
+/// \return ,ѹڵĽ
+size_t DnsCache::size() {
+	pthread_mutex_lock( &_lock );
+	size_t count = _cache.size();
+	pthread_mutex_unlock( &_lock );
+	return count;
+}
+
+/// ̨ˢ߳
+/// ˢ߳ÿinterval½ڲһʱʹù,
+/// ʧʱԭ,δʹõĹڽɾ,
+/// ˲ʱ
+/// \param interval ˢ¼ʱ,λΪ,ĬΪ0ʱһ
+/// \retval true ɹ
+/// \retval false Ѿߴ߳ʧ
+bool DnsCache::start_refresh( const int interval ) {
+	pthread_mutex_lock( &_lock );
+	if ( _running ) {
+		pthread_mutex_unlock( &_lock );
+		return false;
+	}
+	_interval = ( interval>0 ) ? interval : max( _ttl/2, 1 );
+	_stop = false;
+	_running = ( pthread_create(&_thread,NULL,DnsCache::refresher,this) == 0 );
+	bool res = _running;
+	pthread_mutex_unlock( &_lock );
+	return res;
+}
+
+/// ֹ̨ͣˢ߳
+void DnsCache::stop_refresh() {
+	pthread_mutex_lock( &_lock );
+	if ( !_running ) {
+		pthread_mutex_unlock( &_lock );
+		return;
+	}
+	_stop = true;
+	pthread_cond_broadcast( &_wake );
+	pthread_mutex_unlock( &_lock );
+
+	pthread_join( _thread, NULL );
+	pthread_mutex_lock( &_lock );
+	_running = false;
+	pthread_mutex_unlock( &_lock );
+}
+
+/// ̺߳
+/// \param cache DnsCache
+/// \return NULL
+void* DnsCache::refresher( void *cache ) {
+	DnsCache *self = static_cast<DnsCache*>( cache );
+
+	pthread_mutex_lock( &self->_lock );
+	while ( !self->_stop ) {
+		struct timespec ts;
+		ts.tv_sec = time( 0 ) + self->_interval;
+		ts.tv_nsec = 0;
+		pthread_cond_timedwait( &self->_wake, &self->_lock, &ts );
+		if ( self->_stop )
+			break;
+
+		pthread_mutex_unlock( &self->_lock );
+		self->refresh();
+		pthread_mutex_lock( &self->_lock );
+	}
+	pthread_mutex_unlock( &self->_lock );
+	return NULL;
+}
+
+/// ˢ¼ڵʹõ
+void DnsCache::refresh() {
+	time_t now = time( 0 );
+	vector<string> domains;
+
+	pthread_mutex_lock( &_lock );
+	map<string,dns_entry>::iterator i = _cache.begin();
+	while ( i != _cache.end() ) {
+		const dns_entry &entry = i->second;
+		if ( entry.expire == 0 ) {
+			// fixed
+			++i;
+		} else if ( entry.used+_ttl > now ) {
+			// hot, expire before next refresh
+			if ( entry.expire <= now+_interval )
+				domains.push_back( i->first );
+			++i;
+		} else if ( entry.expire <= now ) {
+			// cold and expired
+			_cache.erase( i++ );
+		} else {
+			++i;
+		}
+	}
+	pthread_mutex_unlock( &_lock );
+
+	// resolve without lock
+	for ( size_t j=0; j<domains.size(); ++j ) {
+		string ip = gethost_byname( domains[j] );
+		now = time( 0 );
+
+		pthread_mutex_lock( &_lock );
+		map<string,dns_entry>::iterator entry = _cache.find( domains[j] );
+		if ( entry!=_cache.end() && entry->second.expire!=0 ) {
+			if ( ip != "" ) {
+				entry->second.ip = ip;
+				entry->second.expire = now + _ttl;
+			} else if ( entry->second.ip == "" ) {
+				entry->second.expire = now + _negative_ttl;
+			}
+		}
+		pthread_mutex_unlock( &_lock );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// ʼµHTTP
+/// ѷ,ص
+/// \param head ǷΪHEAD,HEADķû,ĬΪfalse
+void HttpResponseParser::reset( const bool head ) {
+	_state = PARSE_STATUS;
+	_head_request = head;
+	_received = 0;
+	_status = 0;
+	_http11 = false;
+	_keepalive = false;
+	_chunked = false;
+	_content_length = string::npos;
+	_remain = 0;
+	_line = 0;
+	_head = "";
+	_trailer = "";
+	_chunk = "";
+	_body = "";
+	_headers.clear();
+}
+
+/// ص
+/// úڷʱֶδݸص,ٱ
+/// \param output ص,Ϊ0ʱȡ
+/// \param arg ص,ĬΪ0
+void HttpResponseParser::set_output( const output_func output, void *arg ) {
+	_output = output;
+	_output_arg = arg;
+}
+
+/// 
+/// ԰ⳤȷֶ,Ľٶȡ
+/// \param data 
+/// \param len ݳ
+/// \return ʹõݳ,СlenʱʣݲڱHTTP
+size_t HttpResponseParser::parse( const char *data, const size_t len ) {
+	size_t pos = 0;
+	size_t start, end, size;
+
+	while ( pos < len ) {
+		switch ( _state ) {
+			case PARSE_STATUS:
+				// HTTP/1.x code reason
+				if ( !this->getline(_head,data,len,pos,start,end) )
+					break;
+				if ( end == start ) {
+					// skip empty lines before status line
+					_head = "";
+					_line = 0;
+					break;
+				}
+				if ( _head.compare(start,5,"HTTP/") != 0 ) {
+					_state = PARSE_ERROR;
+					break;
+				}
+				_http11 = ( _head.compare(start,8,"HTTP/1.0") != 0 );
+				start = _head.find( ' ', start );
+				_status = ( start<end ) ? atoi( _head.c_str()+start+1 ) : 0;
+				_state = PARSE_HEADER;
+				break;
+
+			case PARSE_HEADER:
+				if ( !this->getline(_head,data,len,pos,start,end) )
+					break;
+				if ( end > start )
+					this->parse_header( _head, start, end, false );
+				else
+					this->end_header();
+				break;
+
+			case PARSE_BODY:
+				size = min( _remain, len-pos );
+				if ( !this->output(data+pos,size) )
+					break;
+				pos += size;
+				_remain -= size;
+				if ( _remain == 0 )
+					_state = PARSE_DONE;
+				break;
+
+			case PARSE_UNTIL_CLOSE:
+				if ( !this->output(data+pos,len-pos) )
+					break;
+				pos = len;
+				break;
+
+			case PARSE_CHUNK_SIZE:
+				// size[;ext] CRLF
+				if ( !this->getline(_chunk,data,len,pos,start,end) )
+					break;
+				size = parse_length( _chunk.c_str()+start, end-start, true, _remain );
+				if ( size==0 || (start+size<end && _chunk[start+size]!=';' && !isspace(_chunk[start+size])) ) {
+					_state = PARSE_ERROR;
+					break;
+				}
+				_chunk = "";
+				_line = 0;
+				_state = ( _remain>0 ) ? PARSE_CHUNK_DATA : PARSE_TRAILER;
+				if ( _state == PARSE_TRAILER )
+					_line = _trailer.length();
+				break;
+
+			case PARSE_CHUNK_DATA:
+				size = min( _remain, len-pos );
+				if ( !this->output(data+pos,size) )
+					break;
+				pos += size;
+				_remain -= size;
+				if ( _remain == 0 )
+					_state = PARSE_CHUNK_END;
+				break;
+
+			case PARSE_CHUNK_END:
+				// CRLF after chunk data
+				if ( !this->getline(_chunk,data,len,pos,start,end) )
+					break;
+				_state = ( end==start ) ? PARSE_CHUNK_SIZE : PARSE_ERROR;
+				_chunk = "";
+				_line = 0;
+				break;
+
+			case PARSE_TRAILER:
+				if ( !this->getline(_trailer,data,len,pos,start,end) )
+					break;
+				if ( end > start )
+					this->parse_header( _trailer, start, end, true );
+				else
+					_state = PARSE_DONE;
+				break;
+
+			default:
+				// done, error or aborted
+				_received += pos;
+				return pos;
+		}
+
+		if ( _head.length()+_trailer.length()+_chunk.length() > HTTP_HEAD_MAX )
+			_state = PARSE_ERROR;
+		if ( _state==PARSE_DONE || _state==PARSE_ERROR || _state==PARSE_ABORTED )
+			break;
+	}
+
+	_received += pos;
+	return pos;
+}
+
+/// ѹر
+/// ûContent-LengthҲchunkedӹرʱ
+/// \retval true ѷ
+/// \retval false Ĳ
+bool HttpResponseParser::finish() {
+	if ( _state == PARSE_UNTIL_CLOSE )
+		_state = PARSE_DONE;
+	return _state == PARSE_DONE;
+}
+
+/// ȡһ,з
+/// ׷ӵbuffer,нCRLFLF
+/// \param buffer л,_lineλÿʼΪǰ
+/// \param data 
+/// \param len ݳ
+/// \param pos ݶȡλ,ȡ
+/// \param start пʼλ
+/// \param end нλ,з
+/// \retval true Ѷȡһ
+/// \retval false Ѷ,в
+bool HttpResponseParser::getline( string &buffer, const char *data, const size_t len, 
+	size_t &pos, size_t &start, size_t &end )
+{
+	const char *eol = static_cast<const char*>( memchr(data+pos,'\n',len-pos) );
+	if ( eol == 0 ) {
+		buffer.append( data+pos, len-pos );
+		pos = len;
+		return false;
+	}
+
+	buffer.append( data+pos, eol-data-pos+1 );
+	pos = eol - data + 1;
+	start = _line;
+	end = buffer.length() - 1;
+	if ( end>start && buffer[end-1]=='\r' )
+		--end;
+	_line = buffer.length();
+	return true;
+}
+
+/// Header
+/// ֻƼֵλ,
+/// \param buffer ͷtrailerԭ
+/// \param start пʼλ
+/// \param end нλ
+/// \param trailer ǷΪtrailer
+void HttpResponseParser::parse_header( const string &buffer, const size_t start, const size_t end, 
+	const bool trailer )
+{
+	size_t colon = buffer.find( ':', start );
+	if ( colon >= end )
+		return;
+
+	header_slice slice;
+	slice.name = start;
+	slice.name_len = colon - start;
+	while ( slice.name_len>0 && isspace(buffer[start+slice.name_len-1]) )
+		--slice.name_len;
+
+	size_t value = colon + 1;
+	size_t value_end = end;
+	while ( value<value_end && isspace(buffer[value]) )
+		++value;
+	while ( value_end>value && isspace(buffer[value_end-1]) )
+		--value_end;
+	slice.value = value;
+	slice.value_len = value_end - value;
+	slice.trailer = trailer;
+
+	if ( slice.name_len > 0 )
+		_headers.push_back( slice );
+}
+
+/// ͷ
+/// HEAD󡢷״̬Transfer-EncodingContent-Lengthȷĸʽ
+void HttpResponseParser::end_header() {
+	// 1xx interim response, parse next response
+	if ( _status>=100 && _status<200 && _status!=101 ) {
+		_head = "";
+		_headers.clear();
+		_line = 0;
+		_status = 0;
+		_state = PARSE_STATUS;
+		return;
+	}
+
+	// headers
+	String conn;
+	for ( size_t i=0; i<_headers.size(); ++i ) {
+		const char *value = _head.c_str() + _headers[i].value;
+		if ( this->match(i,"Content-Length") ) {
+			// invalid, overflowed or conflicting length
+			size_t length;
+			size_t len = _headers[i].value_len;
+			if ( len==0 || parse_length(value,len,false,length)!=len ||
+				( _content_length!=string::npos && _content_length!=length ) )
+			{
+				_state = PARSE_ERROR;
+				return;
+			}
+			_content_length = length;
+		} else if ( this->match(i,"Transfer-Encoding") ) {
+			String encoding = this->header_value( i );
+			encoding.lower();
+			_chunked = ( encoding.find("chunked") != encoding.npos );
+		} else if ( this->match(i,"Connection") ) {
+			conn = this->header_value( i );
+			conn.lower();
+		}
+	}
+	_keepalive = _http11 ? ( conn.find("close")==conn.npos ) : ( conn.find("keep-alive")!=conn.npos );
+
+	if ( _head_request || _status==204 || _status==304 ) {
+		// no body
+		_state = PARSE_DONE;
+	} else if ( _chunked ) {
+		_line = 0;
+		_state = PARSE_CHUNK_SIZE;
+	} else if ( _content_length != string::npos ) {
+		_remain = _content_length;
+		if ( _output == 0 )
+			_body.reserve( min(_content_length,HTTP_RESERVE_MAX) );
+		_state = ( _remain>0 ) ? PARSE_BODY : PARSE_DONE;
+	} else {
+		// read until closed
+		_keepalive = false;
+		_state = PARSE_UNTIL_CLOSE;
+	}
+}
+
+/// 
+/// \param data 
+/// \param len ݳ
+/// \retval true ɹ
+/// \retval false صfalse,״̬ΪPARSE_ABORTED
+bool HttpResponseParser::output( const char *data, const size_t len ) {
+	if ( len == 0 )
+		return true;
+	if ( _output == 0 ) {
+		_body.append( data, len );
+		return true;
+	}
+	if ( !_output(data,len,_output_arg) ) {
+		_state = PARSE_ABORTED;
+		return false;
+	}
+	return true;
+}
+
+/// HeaderǷͬ
+/// \param index Header
+/// \param name Header,ִСд
+/// \retval true ͬ
+/// \retval false ͬ
+bool HttpResponseParser::match( const size_t index, const string &name ) const {
+	const header_slice &slice = _headers[index];
+	const string &buffer = slice.trailer ? _trailer : _head;
+	return slice.name_len==name.length() 
+		&& strncasecmp( buffer.c_str()+slice.name, name.c_str(), slice.name_len )==0;
+}
+
+/// ״̬
+/// \return ״̬,з
+string HttpResponseParser::status_line() const {
+	size_t end = _head.find( '\n' );
+	if ( end == _head.npos )
+		return string( "" );
+	if ( end>0 && _head[end-1]=='\r' )
+		--end;
+	return _head.substr( 0, end );
+}
+
+/// Header
+/// \param index Header,˳,trailer
+/// \return Header
+string HttpResponseParser::header_name( const size_t index ) const {
+	if ( index >= _headers.size() )
+		return string( "" );
+	const header_slice &slice = _headers[index];
+	const string &buffer = slice.trailer ? _trailer : _head;
+	return buffer.substr( slice.name, slice.name_len );
+}
+
+/// Headerֵ
+/// \param index Header,˳,trailer
+/// \return Headerֵ
+string HttpResponseParser::header_value( const size_t index ) const {
+	if ( index >= _headers.size() )
+		return string( "" );
+	const header_slice &slice = _headers[index];
+	const string &buffer = slice.trailer ? _trailer : _head;
+	return buffer.substr( slice.value, slice.value_len );
+}
+
+/// ָƵHeaderֵ
+/// Headerֵ,صָ´ηݻreset()ǰЧ
+/// \param name Header,ִСд,жʱصһ
+/// \param len Headerֵ
+/// \return Headerֵ,ûиHeaderʱ0
+const char* HttpResponseParser::header( const string &name, size_t &len ) const {
+	for ( size_t i=0; i<_headers.size(); ++i ) {
+		if ( this->match(i,name) ) {
+			const header_slice &slice = _headers[i];
+			len = slice.value_len;
+			return ( slice.trailer ? _trailer : _head ).c_str() + slice.value;
+		}
+	}
+	len = 0;
+	return 0;
+}
+
+/// ָƵHeaderֵ
+/// \param name Header,ִСд,жʱصһ
+/// \return Headerֵ,ûиHeaderʱؿַ
+string HttpResponseParser::header( const string &name ) const {
+	size_t len;
+	const char *value = this->header( name, len );
+	return ( value!=0 ) ? string( value, len ) : string( "" );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// ؽ̹ӳ
+/// HttpClientʹkeep-aliveʱʹøӳ
+/// \return ӳ
+HttpConnectionPool& HttpConnectionPool::instance() {
+	static HttpConnectionPool pool;
+	return pool;
+}
+
+/// 캯
+/// \param idle_timeout ӳʱʱ,λΪ,ĬΪ30
+/// \param max_idle ÿౣĿ,ĬΪ8
+/// \param max_conns ÿͬʱʹõ,ĬΪ0
+HttpConnectionPool::HttpConnectionPool( const int idle_timeout, const size_t max_idle,
+	const size_t max_conns ):
+_idle_timeout(idle_timeout), _max_idle(max_idle), _max_conns(max_conns)
+{
+	pthread_mutex_init( &_lock, NULL );
+	pthread_cond_init( &_released, NULL );
+}
+
+/// 
+HttpConnectionPool::~HttpConnectionPool() {
+	this->clear();
+	pthread_cond_destroy( &_released );
+	pthread_mutex_destroy( &_lock );
+}
+
+/// ÿӳʱʱ
+/// ʱĿ´ȡ߹黹ͬһʱر,
+/// ӦСڷkeep-aliveʱʱ
+/// \param idle_timeout ӳʱʱ,λΪ
+void HttpConnectionPool::set_idle_timeout( const int idle_timeout ) {
+	pthread_mutex_lock( &_lock );
+	_idle_timeout = idle_timeout;
+	pthread_mutex_unlock( &_lock );
+}
+
+/// ÿౣĿ
+/// ʱ黹ֱӹر,Ϊ0ʱ
+/// \param max_idle 
+void HttpConnectionPool::set_max_idle( const size_t max_idle ) {
+	pthread_mutex_lock( &_lock );
+	_max_idle = max_idle;
+	pthread_mutex_unlock( &_lock );
+}
+
+/// ÿͬʱʹõ
+/// ȡĿӼ½,set_max_idle(),
+/// ﵽʱacquire()ȴͷ
+/// \param max_conns ,Ϊ0ʱ
+void HttpConnectionPool::set_max_conns( const size_t max_conns ) {
+	pthread_mutex_lock( &_lock );
+	_max_conns = max_conns;
+	pthread_cond_broadcast( &_released );
+	pthread_mutex_unlock( &_lock );
+}
+
+/// ռ
+/// ÿʹǰ,ɺrelease()ͷ,
+/// ͬʱʹõѴﵽset_max_conns()ʱȴ
+/// \param addr IP
+/// \param port ˿
+/// \param timeout ȴʱʱ,λΪ,Ϊ0ʱһֱȴ,С0ʱȴ,ĬΪ0
+/// \retval true ɹ
+/// \retval false ȴʱ
+bool HttpConnectionPool::acquire( const string &addr, const int port, const int timeout ) {
+	string key = addr + ":" + itos( port );
+	struct timeval now;
+	gettimeofday( &now, NULL );
+	struct timespec expire;
+	expire.tv_sec = now.tv_sec + timeout;
+	expire.tv_nsec = now.tv_usec*1000;
+
+	pthread_mutex_lock( &_lock );
+	while ( _max_conns>0 && _active[key]>=_max_conns ) {
+		if ( timeout < 0 )
+			break;
+		if ( timeout == 0 )
+			pthread_cond_wait( &_released, &_lock );
+		else if ( pthread_cond_timedwait(&_released,&_lock,&expire) == ETIMEDOUT )
+			break;
+	}
+	bool acquired = ( _max_conns==0 || _active[key]<_max_conns );
+	if ( acquired )
+		++_active[key];
+	pthread_mutex_unlock( &_lock );
+	return acquired;
+}
+
+/// ͷ
+/// ѹ黹߹رպ,ѵȴacquire()
+/// \param addr IP
+/// \param port ˿
+void HttpConnectionPool::release( const string &addr, const int port ) {
+	string key = addr + ":" + itos( port );
+
+	pthread_mutex_lock( &_lock );
+	map<string,size_t>::iterator i = _active.find( key );
+	if ( i != _active.end() && --i->second == 0 )
+		_active.erase( i );
+	pthread_cond_broadcast( &_released );
+	pthread_mutex_unlock( &_lock );
+}
+
+/// ȡ
+/// ȡʹõ,رճʱѱرյ
+/// \param addr IP
+/// \param port ˿
+/// \return ɹsocket,ûпõĿӷ-1
+int HttpConnectionPool::checkout( const string &addr, const int port ) {
+	string key = addr + ":" + itos( port );
+	vector<int> expired;
+	int fd = -1;
+
+	while ( fd == -1 ) {
+		pthread_mutex_lock( &_lock );
+		map<string,list<pool_conn> >::iterator i = _conns.find( key );
+		if ( i == _conns.end() ) {
+			pthread_mutex_unlock( &_lock );
+			break;
+		}
+
+		// expired connections are at front
+		time_t now = time( 0 );
+		list<pool_conn> &conns = i->second;
+		while ( !conns.empty() && conns.front().idle+_idle_timeout<=now ) {
+			expired.push_back( conns.front().fd );
+			conns.pop_front();
+		}
+		if ( !conns.empty() ) {
+			fd = conns.back().fd;
+			conns.pop_back();
+		}
+		if ( conns.empty() )
+			_conns.erase( i );
+		pthread_mutex_unlock( &_lock );
+
+		if ( fd == -1 )
+			break;
+		if ( !alive(fd) ) {
+			expired.push_back( fd );
+			fd = -1;
+		}
+	}
+
+	for ( size_t i=0; i<expired.size(); ++i )
+		close( expired[i] );
+	return fd;
+}
+
+/// 黹
+/// ӱȡһHTTP,ʱرո
+/// \param addr IP
+/// \param port ˿
+/// \param fd socket
+void HttpConnectionPool::checkin( const string &addr, const int port, const int fd ) {
+	if ( fd < 0 )
+		return;
+
+	string key = addr + ":" + itos( port );
+	vector<int> expired;
+	time_t now = time( 0 );
+
+	pthread_mutex_lock( &_lock );
+	list<pool_conn> &conns = _conns[key];
+	while ( !conns.empty() && conns.front().idle+_idle_timeout<=now ) {
+		expired.push_back( conns.front().fd );
+		conns.pop_front();
+	}
+	if ( conns.size() < _max_idle && _idle_timeout > 0 ) {
+		pool_conn conn;
+		conn.fd = fd;
+		conn.idle = now;
+		conns.push_back( conn );
+	} else {
+		expired.push_back( fd );
+	}
+	if ( conns.empty() )
+		_conns.erase( key );
+	pthread_mutex_unlock( &_lock );
+
+	for ( size_t i=0; i<expired.size(); ++i )
+		close( expired[i] );
+}
+
+/// رп
+void HttpConnectionPool::clear() {
+	pthread_mutex_lock( &_lock );
+	map<string,list<pool_conn> >::const_iterator i;
+	for ( i=_conns.begin(); i!=_conns.end(); ++i ) {
+		list<pool_conn>::const_iterator j;
+		for ( j=i->second.begin(); j!=i->second.end(); ++j )
+			close( j->fd );
+	}
+	_conns.clear();
+	pthread_mutex_unlock( &_lock );
+}
+
+/// ؿ
+/// \return 
+size_t HttpConnectionPool::size() {
+	size_t count = 0;
+	pthread_mutex_lock( &_lock );
+	map<string,list<pool_conn> >::const_iterator i;
+	for ( i=_conns.begin(); i!=_conns.end(); ++i )
+		count += i->second.size();
+	pthread_mutex_unlock( &_lock );
+	return count;
+}
+
+/// ǷȻ
+/// ϲӦпɶ,ɶʱΪѹرӻ߶
+/// \param fd socket
+/// \retval true 
+/// \retval false 
+bool HttpConnectionPool::alive( const int fd ) {
+	char c;
+	ssize_t readed = recv( fd, &c, 1, MSG_PEEK|MSG_DONTWAIT );
+	return ( readed<0 && (errno==EAGAIN||errno==EWOULDBLOCK) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 /// ָHTTPHeader
 /// \param name Header
 /// \param value Headerֵ,
@@ -218,17 +1170,44 @@ void HttpClient::parse_url( const string &urlstr, string &parsed_host, string &p
 	parsed_port = 80;
 	if ( (pos=parsed_host.rfind(":")) != parsed_host.npos ) {
 		// hostname:post
-		parsed_port = stoi( parsed_host.substr(pos+1) );
+		parsed_port = webapp::stoi( parsed_host.substr(pos+1) );
 		parsed_host = parsed_host.substr( 0, pos );
 	}
 	
 	// parse addr
-	if ( !isip(parsed_host) )
-		parsed_addr = gethost_byname( parsed_host );
-	else
-		parsed_addr = parsed_host;
+	parsed_addr = DnsCache::instance().resolve( parsed_host );
 }
 				   
+/// ص
+/// úHTTPĲٱcontent(),ڽʱֶδݸص,
+/// chunkedڽʱν벢ֶδ
+/// \param output ص,Ϊݡݳȡص,falseʱֹͣ,Ϊ0ʱȡ
+/// \param arg ص,ĬΪ0
+void HttpClient::set_output( const output_func output, void *arg ) {
+	_output = output;
+	_output_arg = arg;
+	_output_file = "";
+}
+
+/// ļ
+/// úHTTPĲٱcontent(),ڽʱдļ,
+/// ļÿʼʱ
+/// \param file ļ·,Ϊַʱȡ
+void HttpClient::set_output( const string &file ) {
+	_output = 0;
+	_output_arg = 0;
+	_output_file = file;
+}
+
+/// Ƿʹkeep-alive
+/// ʹʱɺӹ黹HttpConnectionPool,ͬһĺظʹø,
+/// ͬʱHttpConnectionPool::set_max_conns(),ﵽʱʱʱڵȴ,
+/// Ĭϲʹ,ÿر
+/// \param keepalive Ƿʹ,ĬΪtrue
+void HttpClient::set_keepalive( const bool keepalive ) {
+	_keepalive = keepalive;
+}
+
 /// HTTPַ
 /// \param url URL
 /// \param params URLCGI
@@ -258,17 +1237,21 @@ string HttpClient::gen_httpreq( const string &url, const string &params,
 			request += i->first + ": " + i->second + HTTP_CRLF;
 	}
 
-	request += "Connection: close" + HTTP_CRLF;
+	if ( _keepalive )
+		request += "Connection: keep-alive" + HTTP_CRLF;
+	else
+		request += "Connection: close" + HTTP_CRLF;
 
 	if ( method == "POST" ) {
-		// post data
+		// post data, exactly Content-Length bytes after header
 		request += "Content-Type: application/x-www-form-urlencoded" + HTTP_CRLF;
 		request += "Content-Length: " + itos(params.length()) + HTTP_CRLF;
 		request += HTTP_CRLF;
-		request += params + HTTP_CRLF;
+		request += params;
+	} else {
+		request += HTTP_CRLF;
 	}
 
-	request += HTTP_CRLF;
 	return request;
 }
 
@@ -283,8 +1266,39 @@ string HttpClient::gen_httpreq( const string &url, const string &params,
 /// \retval false ִʧ
 bool HttpClient::request( const string &url, const string &host, const int port, 
 	const string &method, const int timeout )
+{
+	string parsed_addr;
+	int parsed_port;
+	if ( !this->prepare(url,host,port,method,parsed_addr,parsed_port) )
+		return false;
+
+	// request
+	HttpConnectionPool &pool = HttpConnectionPool::instance();
+	if ( _keepalive && !pool.acquire(parsed_addr,parsed_port,timeout) ) {
+		_errno = ERROR_CONNECTION_LIMIT;
+	} else {
+		_errno = this->transfer( parsed_addr, parsed_port, method=="HEAD", timeout );
+		if ( _keepalive )
+			pool.release( parsed_addr, parsed_port );
+	}
+	return this->finish();
+}
+
+/// HTTP
+/// ͬrequest(),ɵHTTP󱣴_request
+/// \param url HTTPURL
+/// \param host IP
+/// \param port ˿
+/// \param method HTTPMethod
+/// \param addr طIP
+/// \param addr_port Ӷ˿
+/// \retval true ɹ
+/// \retval false ַϢ
+bool HttpClient::prepare( const string &url, const string &host, const int port, 
+	const string &method, string &addr, int &addr_port )
 {
 	_errno = ERROR_NULL;
+	_parser.reset();
 	
 	// parse host,port,url info
 	string parsed_host, parsed_addr, parsed_url, parsed_param;
@@ -305,7 +1319,7 @@ bool HttpClient::request( const string &url, const string &host, const int port,
 	if ( host != "" ) {
 		if ( !isip(parsed_host) ) {
 			parsed_host = host;
-			parsed_addr = gethost_byname( parsed_host );
+			parsed_addr = DnsCache::instance().resolve( parsed_host );
 		} else {
 			parsed_addr = host;
 		}
@@ -317,23 +1331,186 @@ bool HttpClient::request( const string &url, const string &host, const int port,
 	
 	// generate request string
 	_request = this->gen_httpreq( parsed_url, _params, parsed_host, method );
-	// request
-	int reqres = tcp_request( parsed_addr, parsed_port, _request, _response, timeout );
-	if ( reqres != 0 ) {
-		_errno = static_cast<error_msg>( reqres );
-		return false;
+	addr = parsed_addr;
+	addr_port = parsed_port;
+
+	// output file
+	if ( _output_file != "" ) {
+		if ( _output_fp != 0 )
+			fclose( _output_fp );
+		if ( (_output_fp=fopen(_output_file.c_str(),"wb")) == 0 ) {
+			_errno = ERROR_OUTPUT;
+			return false;
+		}
 	}
-	
-	// parse response
-	if ( _response == "" ) {
-		_errno = ERROR_RESPONSE_NULL;
-		return false;
+	return true;
+}
+
+/// ɵHTTP
+/// ʱرļ
+/// \retval true ɹ
+/// \retval false ʧܡӦΪջ߲
+bool HttpClient::finish() {
+	bool res = ( _errno == ERROR_NULL );
+	if ( res ) {
+		if ( _parser.received() == 0 ) {
+			_errno = ERROR_RESPONSE_NULL;
+			res = false;
+		} else if ( !_parser.finish() ) {
+			// closed before Content-Length or last chunk
+			_errno = ERROR_RESPONSE_INCOMPLETE;
+			res = false;
+		}
 	}
 
-	this->parse_response( _response );
+	if ( res )
+		this->parse_response();
+
+	if ( _output_fp != 0 ) {
+		if ( fclose(_output_fp)!=0 && res ) {
+			_errno = ERROR_OUTPUT;
+			res = false;
+		}
+		_output_fp = 0;
+	}
+	return res;
+}
+
+/// ʼHTTP
+/// \param head ǷΪHEAD
+void HttpClient::begin_response( const bool head ) {
+	_parser.reset( head );
+	if ( _output!=0 || _output_fp!=0 )
+		_parser.set_output( HttpClient::parser_output, this );
+	else
+		_parser.set_output( 0 );
+	_reusable = true;
+}
+
+/// յ
+/// ʱڷʱֱд
+/// \param data 
+/// \param len ݳ
+/// \param complete HTTPǷ
+/// \retval ERROR_NULL ɹ
+/// \retval ERROR_RESPONSE_INVALID Ӧʽ
+/// \retval ERROR_OUTPUT дʧ
+HttpClient::error_msg HttpClient::receive( const char *data, const size_t len, bool &complete ) {
+	// extra data after response
+	if ( _parser.parse(data,len) < len )
+		_reusable = false;
+
+	complete = _parser.done();
+	if ( _parser.state() == HttpResponseParser::PARSE_ABORTED )
+		return ERROR_OUTPUT;
+	if ( _parser.state() == HttpResponseParser::PARSE_ERROR )
+		return ERROR_RESPONSE_INVALID;
+	if ( complete )
+		_reusable = _reusable && _parser.keepalive();
+	return ERROR_NULL;
+}
+
+/// ص
+/// \param data 
+/// \param len ݳ
+/// \param client HttpClient
+/// \retval true ɹ
+/// \retval false ʧ
+bool HttpClient::parser_output( const char *data, const size_t len, void *client ) {
+	HttpClient *self = static_cast<HttpClient*>( client );
+	if ( self->_output != 0 )
+		return self->_output( data, len, self->_output_arg );
+	if ( self->_output_fp != 0 )
+		return ( fwrite(data,1,len,self->_output_fp) == len );
 	return true;
 }
 
+/// HTTPȡûӦ
+/// HTTP/1.1ĳȶȡӦ,ʹkeep-aliveʱʹӳе,
+/// ȡҷʱ黹,
+/// ظʹõյӦǰرʱʹ·һ
+/// \param addr IP
+/// \param port ˿
+/// \param head ǷΪHEAD
+/// \param timeout ÿζȡĳʱʱ,λΪ,Ϊ0жϳʱ
+/// \return Ϣ
+HttpClient::error_msg HttpClient::transfer( const string &addr, const int port, 
+	const bool head, const int timeout )
+{
+	HttpConnectionPool &pool = HttpConnectionPool::instance();
+	vector<char> buff( HTTP_RECV_SIZE );
+
+	for ( int retry=0; retry<2; ++retry ) {
+		// connect
+		int fd = ( _keepalive && retry==0 ) ? pool.checkout( addr, port ) : -1;
+		bool reused = ( fd >= 0 );
+		if ( !reused ) {
+			fd = tcp_connect( addr, port );
+			if ( fd < 0 )
+				return static_cast<error_msg>( -fd );
+		}
+
+		// send request
+		if ( send(fd,_request.c_str(),_request.length(),MSG_NOSIGNAL) < 0 ) {
+			close( fd );
+			if ( reused )
+				continue;
+			return ERROR_SEND_REQUEST;
+		}
+
+		// recv response
+		this->begin_response( head );
+		bool complete = false;
+		bool failed = false;
+		fd_set fds;
+		struct timeval tv;
+		while ( !complete ) {
+			if ( timeout > 0 ) {
+				FD_ZERO( &fds );
+				FD_SET( fd, &fds );
+				tv.tv_sec = timeout;
+				tv.tv_usec = 0;
+				if ( select(fd+1,&fds,NULL,NULL,&tv) <= 0 ) {
+					close( fd );
+					return ERROR_RESPONSE_TIMEDOUT;
+				}
+			}
+
+			ssize_t readed = recv( fd, &buff[0], buff.size(), 0 );
+			if ( readed < 0 && errno == EINTR )
+				continue;
+			if ( readed <= 0 ) {
+				failed = ( readed < 0 );
+				break;
+			}
+
+			error_msg err = this->receive( &buff[0], readed, complete );
+			if ( err != ERROR_NULL ) {
+				close( fd );
+				return err;
+			}
+		}
+
+		// closed or reset before response, stale connection
+		if ( _parser.received()==0 && reused ) {
+			close( fd );
+			continue;
+		}
+		if ( failed ) {
+			close( fd );
+			return ERROR_RESPONSE_INCOMPLETE;
+		}
+
+		if ( _keepalive && complete && _reusable )
+			pool.checkin( addr, port, fd );
+		else
+			close( fd );
+		return ERROR_NULL;
+	}
+
+	return ERROR_SEND_REQUEST;
+}
+
 /// URL ǷЧ
 /// \param url HTTPURL
 /// \param server IP,Ϊַݲ1,ĬΪַ,
@@ -359,76 +1536,39 @@ bool HttpClient::exist( const string &url, const string &server,
 }
 
 /// HTTP
-/// \param response HTTPַ
-void HttpClient::parse_response( const string &response ) {
+/// HttpResponseParserȡ״̬Header,Ĳ
+void HttpClient::parse_response() {
 	// clear response status
 	_status = "";
 	_content = "";
 	_gets.clear();
 
-	// split header and body
-	size_t pos;
-	String head;
-	String body;
-	if ( (pos=response.find(DOUBLE_CRLF)) != response.npos ) {
-		head = response.substr( 0, pos );
-		body = response.substr( pos+4 );
-	} else if ( (pos=response.find("\n\n")) != response.npos ) {
-		head = response.substr( 0, pos );
-		body = response.substr( pos+2 );
-	} else {
+	if ( !_parser.header_done() ) {
 		_errno = ERROR_RESPONSE_INVALID;
 		return;
-	}	
-				
-	// parse status
-	String status;
-	if ( (pos=head.find(HTTP_CRLF)) != head.npos ) {
-		status = head.substr( 0, pos );
-		head = head.substr( pos+2 );
-		
-		// HTTP/1.1 status_number description_string
-		status.trim();
-		_gets["HTTP_STATUS"] = status;
-		if ( strncmp(status.c_str(),"HTTP/",5) == 0 ) {
-			size_t b1, b2;
-			if ( (b1=status.find(" "))!=status.npos
-				 && (b2=status.find(" ",b1+1))!=status.npos )
-				_status = status.substr( b1+1, b2-b1-1 );
-		}
 	}
 
+	// HTTP/1.1 status_number description_string
+	_gets["HTTP_STATUS"] = _parser.status_line();
+	if ( _parser.status() > 0 )
+		_status = itos( _parser.status() );
+
 	// http response status
 	if ( _status.length()>1 && _status[0]!='2' )
 		_errno = ERROR_HTTPSTATUS;
-	
+
 	// parse header
-	String line, name, value;
-	vector<String> hds = head.split( "\n" );
-	for ( size_t i=0; i<hds.size(); ++i ) {
-		line = hds[i];
-		line.trim();
-		
-		// name: value
-		if ( (pos=line.find(":")) != line.npos ) {
-			name = line.substr( 0, pos );
-			name.trim();
-			value = line.substr( pos+1 );
-			value.trim();
-			
-			if ( name != "" ) {
-				if ( _gets[name] != "" )
-					_gets[name] += "\n";
-				_gets[name] += value;
-			}
-		}
+	string name;
+	for ( size_t i=0; i<_parser.headers(); ++i ) {
+		name = _parser.header_name( i );
+		string &value = _gets[name];
+		if ( value != "" )
+			value += "\n";
+		value += _parser.header_value( i );
 	}
-	
-	// parse body
-	if ( this->get_header("Transfer-Encoding") == "chunked" )
-		_content = this->parse_chunked( body );
-	else
-		_content = body;
+
+	// body
+	_parser.swap_body( _content );
 }
 
 /// ȡָHTTPHeader
@@ -481,7 +1621,7 @@ string HttpClient::dump_header() {
 /// \retval false ʧ
 bool HttpClient::done() const {
 	if ( _status.isnum() ) {
-		int ret = stoi( _status );
+		int ret = webapp::stoi( _status );
 		if ( ret>=100 && ret<300 )
 			return true;
 	}
@@ -493,48 +1633,311 @@ void HttpClient::clear() {
 	// set
 	_params = "";
 	_sets.clear();
+	_output = 0;
+	_output_arg = 0;
+	_output_file = "";
 	
 	// get
+	_parser.reset();
 	_status = "";
 	_content = "";
 	_gets.clear();
 }
 
-/// HTTPchunkedcontent
-/// \param chunkedstr chunkedַ
-/// \return ؽַ
-string HttpClient::parse_chunked( const string &chunkedstr ) {
-	char crlf[3] = "\x0D\x0A";
-	size_t pos, lastpos;
-	int size = 0;
-	string hexstr;
+////////////////////////////////////////////////////////////////////////////////
 
-	// location HTTP_CRLF		
-	if ( (pos=chunkedstr.find(crlf)) != chunkedstr.npos ) {
-		hexstr = chunkedstr.substr( 0, pos );
-		size = stoi( hexstr, ios::hex );
+/// HTTP
+/// ͬHttpClient::request(),perform()ʱִ,
+/// ͬһHttpClientֻһ,HttpClientperform()ǰ뱣Ч
+/// \param client ִHttpClient,Headerkeep-aliveͬ
+/// \param url HTTPURL
+/// \param server IP,Ϊַݲurl,ĬΪַ
+/// \param port ˿,ĬΪ80
+/// \param method HTTPMethod,ĬΪ"GET"
+/// \param timeout ʱʱ,λΪ,perform()ʼ,ĬΪ5,Ϊ0жϳʱ
+/// \param callback ʱĻص,ĬΪ0
+/// \param arg ص,ĬΪ0
+/// \return ,0ʼ˳
+size_t MultiHttpClient::add( HttpClient &client, const string &url, const string &server, 
+	const int port, const string &method, const int timeout, 
+	const callback_func callback, void *arg )
+{
+	multi_req req;
+	req.client = &client;
+	req.url = url;
+	req.server = server;
+	req.port = port;
+	req.method = method;
+	req.timeout = timeout;
+	req.callback = callback;
+	req.arg = arg;
+	req.addr_port = 0;
+	req.fd = -1;
+	req.reused = false;
+	req.sent = 0;
+	req.expire = 0;
+	req.state = MULTI_CONNECT;
+	_reqs.push_back( req );
+	return _reqs.size() - 1;
+}
+
+/// ִHTTP
+/// ͬʱ,ȫɻ߳ʱ󷵻,
+/// ÿʱøĻص,˳Ϊ˳
+/// \param deadline ܳʱʱ,λΪ,ʱδɵΪERROR_RESPONSE_TIMEDOUT,
+/// ĬΪ0ֻжÿĳʱʱ
+/// \retval true ִгɹ
+/// \retval false ִʧ,ϢHttpClient
+bool MultiHttpClient::perform( const int deadline ) {
+	long long start = now_msec();
+	long long overall = ( deadline>0 ) ? start+deadline : 0;
+	int epfd = epoll_create( _reqs.size()+1 );
+	_buffer.resize( HTTP_RECV_SIZE );
+
+	// start
+	size_t active = 0;
+	for ( size_t i=0; i<_reqs.size(); ++i ) {
+		multi_req &req = _reqs[i];
+		req.state = MULTI_CONNECT;
+		req.fd = -1;
+		req.reused = false;
+		req.acquired = false;
+		req.expire = ( req.timeout>0 ) ? start+req.timeout*1000LL : 0;
+		if ( overall>0 && (req.expire==0 || req.expire>overall) )
+			req.expire = overall;
+
+		if ( epfd < 0 ) {
+			this->complete( i, HttpClient::ERROR_CREATE_SOCKET );
+		} else if ( !req.client->prepare(req.url,req.server,req.port,req.method,req.addr,req.addr_port) ) {
+			this->complete( i, req.client->_errno );
+		} else if ( this->connect(epfd,req) ) {
+			++active;
+		}
 	}
-	
-	string res;
-	res.reserve( chunkedstr.length() );
-	
-	while ( size > 0 ) {
-		// append to content
-		res += chunkedstr.substr( pos+2, size );
-		lastpos = pos+size+4;
-		
-		// location next HTTP_CRLF
-		if ( (pos=chunkedstr.find(crlf,lastpos)) != chunkedstr.npos ) {
-			hexstr = chunkedstr.substr( lastpos, pos-lastpos );
-			size = stoi( hexstr, ios::hex );
-		} else {
+
+	// events
+	struct epoll_event events[64];
+	while ( active > 0 ) {
+		// wait until next expire time
+		long long now = now_msec();
+		long long next = 0;
+		for ( size_t i=0; i<_reqs.size(); ++i ) {
+			if ( _reqs[i].state!=MULTI_DONE && _reqs[i].expire>0 && (next==0||_reqs[i].expire<next) )
+				next = _reqs[i].expire;
+		}
+		int wait = ( next>0 ) ? static_cast<int>( max(next-now,0LL) ) : -1;
+		for ( size_t i=0; i<_reqs.size(); ++i ) {
+			// poll for connections released by other threads
+			if ( _reqs[i].state == MULTI_WAIT ) {
+				wait = ( wait<0 ) ? HTTP_WAIT_POLL : min( wait, HTTP_WAIT_POLL );
+				break;
+			}
+		}
+
+		int count = epoll_wait( epfd, events, 64, wait );
+		if ( count<0 && errno!=EINTR )
 			break;
+		for ( int i=0; i<count; ++i ) {
+			multi_req &req = _reqs[events[i].data.u32];
+			if ( req.state!=MULTI_DONE && this->process(epfd,req) )
+				--active;
+		}
+
+		// timeout
+		now = now_msec();
+		for ( size_t i=0; i<_reqs.size(); ++i ) {
+			if ( _reqs[i].state!=MULTI_DONE && _reqs[i].expire>0 && _reqs[i].expire<=now ) {
+				this->complete( i, (_reqs[i].state==MULTI_WAIT) ?
+					HttpClient::ERROR_CONNECTION_LIMIT : HttpClient::ERROR_RESPONSE_TIMEDOUT );
+				--active;
+			}
+		}
+
+		// waiting for connection limit
+		for ( size_t i=0; i<_reqs.size(); ++i ) {
+			if ( _reqs[i].state==MULTI_WAIT && !this->connect(epfd,_reqs[i]) )
+				--active;
 		}
 	}
-			
+
+	// epoll failed
+	for ( size_t i=0; i<_reqs.size(); ++i ) {
+		if ( _reqs[i].state != MULTI_DONE )
+			this->complete( i, HttpClient::ERROR_UNKNOWN );
+	}
+	if ( epfd >= 0 )
+		close( epfd );
+
+	bool res = true;
+	for ( size_t i=0; i<_reqs.size(); ++i ) {
+		if ( _reqs[i].client->_errno != HttpClient::ERROR_NULL )
+			res = false;
+	}
 	return res;
 }
 
+/// ʼ
+/// ʹkeep-aliveʱʹӳе,ʧʱ,
+/// ﵽӳʱȴ,󱣳MULTI_WAIT״̬,perform()ٴε
+/// \param epfd epoll
+/// \param req HTTP
+/// \retval true ѿʼӻڵȴ
+/// \retval false ʧ,ѽ
+bool MultiHttpClient::connect( const int epfd, multi_req &req ) {
+	size_t index = &req - &_reqs[0];
+
+	// connection limit
+	if ( req.client->_keepalive && !req.acquired ) {
+		req.acquired = HttpConnectionPool::instance().acquire( req.addr, req.addr_port, -1 );
+		if ( !req.acquired ) {
+			req.state = MULTI_WAIT;
+			return true;
+		}
+	}
+
+	req.client->begin_response( req.method=="HEAD" );
+	req.sent = 0;
+
+	// reuse connection once
+	req.fd = -1;
+	if ( req.client->_keepalive && !req.reused )
+		req.fd = HttpConnectionPool::instance().checkout( req.addr, req.addr_port );
+	req.reused = ( req.fd >= 0 );
+
+	if ( req.reused ) {
+		fcntl( req.fd, F_SETFL, fcntl(req.fd,F_GETFL)|O_NONBLOCK );
+		req.state = MULTI_SEND;
+	} else {
+		req.fd = tcp_connect( req.addr, req.addr_port, true );
+		if ( req.fd < 0 ) {
+			this->complete( index, static_cast<HttpClient::error_msg>(-req.fd) );
+			return false;
+		}
+		req.state = MULTI_CONNECT;
+	}
+
+	struct epoll_event ev;
+	memset( &ev, 0, sizeof(ev) );
+	ev.events = EPOLLOUT;
+	ev.data.u32 = index;
+	if ( epoll_ctl(epfd,EPOLL_CTL_ADD,req.fd,&ev) < 0 ) {
+		this->complete( index, HttpClient::ERROR_UNKNOWN );
+		return false;
+	}
+	return true;
+}
+
+/// socket¼
+/// ״̬ӡ͡,յHTTPػӹرʱ,
+/// ظʹõյӦǰرʱʹ·һ
+/// \param epfd epoll
+/// \param req HTTP
+/// \retval true ѽ
+/// \retval false δ
+bool MultiHttpClient::process( const int epfd, multi_req &req ) {
+	size_t index = &req - &_reqs[0];
+	HttpClient &client = *req.client;
+
+	// connected
+	if ( req.state == MULTI_CONNECT ) {
+		int err = 0;
+		socklen_t len = sizeof( err );
+		if ( getsockopt(req.fd,SOL_SOCKET,SO_ERROR,&err,&len)<0 || err!=0 ) {
+			this->complete( index, HttpClient::ERROR_CONNECT_SERVER );
+			return true;
+		}
+		req.state = MULTI_SEND;
+	}
+
+	// send request
+	if ( req.state == MULTI_SEND ) {
+		const string &request = client._request;
+		while ( req.sent < request.length() ) {
+			ssize_t sent = send( req.fd, request.data()+req.sent, request.length()-req.sent, MSG_NOSIGNAL );
+			if ( sent < 0 ) {
+				if ( errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR )
+					return false;
+				if ( req.reused ) {
+					close( req.fd );
+					return !this->connect( epfd, req );
+				}
+				this->complete( index, HttpClient::ERROR_SEND_REQUEST );
+				return true;
+			}
+			req.sent += sent;
+		}
+
+		struct epoll_event ev;
+		memset( &ev, 0, sizeof(ev) );
+		ev.events = EPOLLIN;
+		ev.data.u32 = index;
+		epoll_ctl( epfd, EPOLL_CTL_MOD, req.fd, &ev );
+		req.state = MULTI_RECV;
+		return false;
+	}
+
+	// recv response
+	while ( true ) {
+		ssize_t readed = recv( req.fd, &_buffer[0], _buffer.size(), 0 );
+		if ( readed < 0 && (errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR) )
+			return false;
+
+		// closed or reset, stale connection if nothing received
+		if ( readed <= 0 ) {
+			if ( client._parser.received()==0 && req.reused ) {
+				close( req.fd );
+				return !this->connect( epfd, req );
+			}
+			// truncated response is checked by HttpClient::finish()
+			this->complete( index, (readed==0) ? HttpClient::ERROR_NULL : HttpClient::ERROR_RESPONSE_INCOMPLETE );
+			return true;
+		}
+
+		bool done;
+		HttpClient::error_msg err = client.receive( &_buffer[0], readed, done );
+		if ( err!=HttpClient::ERROR_NULL || done ) {
+			// pooled connection may be checked out again by a waiting request
+			struct epoll_event ev;
+			epoll_ctl( epfd, EPOLL_CTL_DEL, req.fd, &ev );
+			this->complete( index, err, done );
+			return true;
+		}
+	}
+}
+
+/// 
+/// رջ߹黹,HTTPزûص
+/// \param index 
+/// \param error Ϣ,ΪERROR_NULLʱHTTP
+/// \param keepalive Ƿ黹,ĬΪfalse
+void MultiHttpClient::complete( const size_t index, const HttpClient::error_msg error, const bool keepalive ) {
+	multi_req &req = _reqs[index];
+	HttpClient &client = *req.client;
+
+	if ( req.fd >= 0 ) {
+		if ( keepalive && client._keepalive && client._reusable ) {
+			// pooled connections are blocking
+			fcntl( req.fd, F_SETFL, fcntl(req.fd,F_GETFL)&~O_NONBLOCK );
+			HttpConnectionPool::instance().checkin( req.addr, req.addr_port, req.fd );
+		} else {
+			close( req.fd );
+		}
+		req.fd = -1;
+	}
+	if ( req.acquired ) {
+		HttpConnectionPool::instance().release( req.addr, req.addr_port );
+		req.acquired = false;
+	}
+	req.state = MULTI_DONE;
+
+	client._errno = error;
+	client.finish();
+	if ( req.callback != 0 )
+		req.callback( index, client, req.arg );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 /// شϢ
 /// \return شϢ
 string HttpClient::error() const {
@@ -559,6 +1962,12 @@ string HttpClient::error() const {
 			return "ERROR_RESPONSE_INVALID";
 		case ERROR_HTTPSTATUS :
 			return "ERROR_HTTPSTATUS:" + status();
+		case ERROR_CONNECTION_LIMIT :
+			return "ERROR_CONNECTION_LIMIT";
+		case ERROR_OUTPUT :
+			return "ERROR_OUTPUT";
+		case ERROR_RESPONSE_INCOMPLETE :
+			return "ERROR_RESPONSE_INCOMPLETE";
 		default : 
 			return "ERROR_UNKNOWN";
 	}
@@ -8,7 +8,11 @@
 
 #include <string>
 #include <vector>
+#include <cstdio>
 #include <map>
+#include <list>
+#include <ctime>
+#include <pthread.h>
 #include "waString.h"
 
 using namespace std;
@@ -27,9 +31,316 @@ string gethost_byname( const string &domain );
 /// жַǷΪЧIP
 bool isip( const string &ipstr );
 
+/// 
+/// ʹgetaddrinfo(),ʧܵĽҲ϶ʱ,̰߳ȫ,
+/// ԴhostsļԤ̶Ľ,̨߳ڹǰˢʹõ,
+/// HttpClient̹ͨʵ
+class DnsCache {
+	public:
+
+	/// ؽ̹
+	static DnsCache& instance();
+
+	/// 캯
+	DnsCache( const int ttl = 300, const int negative_ttl = 10 );
+
+	/// 
+	virtual ~DnsCache();
+
+	/// ûʱ
+	void set_ttl( const int ttl, const int negative_ttl = 10 );
+
+	/// 
+	string resolve( const string &domain );
+	/// ý
+	void set( const string &domain, const string &ip, const int ttl = 0 );
+	/// hostsļ
+	size_t load_hosts( const string &file = "/etc/hosts" );
+	/// ɾ
+	void remove( const string &domain );
+	/// ջ
+	void clear();
+	/// ػ
+	size_t size();
+
+	/// ̨ˢ߳
+	bool start_refresh( const int interval = 0 );
+	/// ֹ̨ͣˢ߳
+	void stop_refresh();
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// ̺߳
+	static void* refresher( void *cache );
+	/// ˢ¼ڵʹõ
+	void refresh();
+
+	/// ֹÿ캯
+	DnsCache( DnsCache &copy );
+	/// ֹÿֵ
+	DnsCache& operator = ( const DnsCache& copy );
+
+	typedef struct {					// 
+		string ip;						// IP,ʧʱΪַ
+		time_t expire;					// ʱ,Ϊ0ʱ
+		time_t used;					// ʹʱ
+	} dns_entry;
+
+	map<string,dns_entry> _cache;		// ,
+	pthread_mutex_t _lock;				// 
+	pthread_cond_t _wake;				// Ҫֹͣˢ߳
+	pthread_t _thread;					// ˢ߳
+	bool _running;						// ˢ߳Ƿ
+	bool _stop;							// ˢ߳ǷҪֹͣ
+	int _interval;						// ˢ¼ʱ
+	int _ttl;							// ʱ
+	int _negative_ttl;					// ʧܽʱ
+};
+
+/// HTTPӳ
+/// HTTP/1.1 keep-alive,ַ˿ڷ,HttpClientظʹ,
+/// ȡʱǷѱر,ÿͬʱʹõ,̰߳ȫ
+class HttpConnectionPool {
+	public:
+
+	/// ؽ̹ӳ
+	static HttpConnectionPool& instance();
+
+	/// 캯
+	HttpConnectionPool( const int idle_timeout = 30, const size_t max_idle = 8,
+		const size_t max_conns = 0 );
+
+	/// 
+	virtual ~HttpConnectionPool();
+
+	/// ÿӳʱʱ
+	void set_idle_timeout( const int idle_timeout );
+	/// ÿౣĿ
+	void set_max_idle( const size_t max_idle );
+	/// ÿͬʱʹõ
+	void set_max_conns( const size_t max_conns );
+
+	/// ռ
+	bool acquire( const string &addr, const int port, const int timeout = 0 );
+	/// ͷ
+	void release( const string &addr, const int port );
+	/// ȡ
+	int checkout( const string &addr, const int port );
+	/// 黹
+	void checkin( const string &addr, const int port, const int fd );
+	/// رп
+	void clear();
+	/// ؿ
+	size_t size();
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// ǷȻ
+	static bool alive( const int fd );
+
+	/// ֹÿ캯
+	HttpConnectionPool( HttpConnectionPool &copy );
+	/// ֹÿֵ
+	HttpConnectionPool& operator = ( const HttpConnectionPool& copy );
+
+	typedef struct {					// 
+		int fd;							// socket
+		time_t idle;					// ʼʱ
+	} pool_conn;
+
+	map<string,list<pool_conn> > _conns;	// ,"ַ:˿"
+	map<string,size_t> _active;			// ʹõ,"ַ:˿"
+	pthread_mutex_t _lock;				// 
+	pthread_cond_t _released;			// ͷ
+	int _idle_timeout;					// ӳʱʱ
+	size_t _max_idle;					// ÿౣĿ
+	size_t _max_conns;					// ÿͬʱʹõ
+};
+
+/// HTTP
+/// ˳ֶ,𲽷״̬СHeaderContent-Lengthchunkedļtrailer,
+/// Ľʱɷ,Ҫȴӹر,
+/// Headerλñڱͷԭ,ȡʱŸ,ĿԱڷʱݸص
+class HttpResponseParser {
+	public:
+
+	/// \enum ״̬
+	enum parse_state {
+		/// ״̬
+		PARSE_STATUS,
+		/// Header
+		PARSE_HEADER,
+		/// Content-Length
+		PARSE_BODY,
+		/// ӹرյ
+		PARSE_UNTIL_CLOSE,
+		/// chunk
+		PARSE_CHUNK_SIZE,
+		/// chunk
+		PARSE_CHUNK_DATA,
+		/// chunkݺĻ
+		PARSE_CHUNK_END,
+		/// trailer
+		PARSE_TRAILER,
+		/// 
+		PARSE_DONE,
+		/// ĸʽ,Ч߲һµContent-Lengthchunk
+		PARSE_ERROR,
+		/// صfalse
+		PARSE_ABORTED
+	};
+
+	/// ص
+	/// Ϊݡݳȡset_output()ʱָĲ,falseʱֹͣ
+	typedef bool (*output_func)( const char *data, const size_t len, void *arg );
+
+	/// 캯
+	HttpResponseParser():
+	_output(0), _output_arg(0)
+	{
+		this->reset();
+	}
+
+	/// 
+	virtual ~HttpResponseParser(){};
+
+	/// ʼµHTTP
+	void reset( const bool head = false );
+	/// ص
+	void set_output( const output_func output, void *arg = 0 );
+
+	/// 
+	size_t parse( const char *data, const size_t len );
+	/// ѹر
+	bool finish();
+
+	/// ط״̬
+	/// \return ״̬
+	inline parse_state state() const {
+		return _state;
+	}
+	/// Ƿѷ
+	/// \return Ƿѷ
+	inline bool done() const {
+		return _state == PARSE_DONE;
+	}
+	/// ͷǷѷ
+	/// \return ͷǷѷ
+	inline bool header_done() const {
+		return _state!=PARSE_STATUS && _state!=PARSE_HEADER && _state!=PARSE_ERROR;
+	}
+	/// ѷֽ
+	/// \return ѷֽ
+	inline size_t received() const {
+		return _received;
+	}
+
+	/// HTTP״̬
+	/// \return HTTP״̬,״̬δʱΪ0
+	inline int status() const {
+		return _status;
+	}
+	/// ״̬
+	string status_line() const;
+	/// طǷ񱣳
+	/// \return Ƿ񱣳
+	inline bool keepalive() const {
+		return _keepalive;
+	}
+	/// ǷΪchunked
+	/// \return ǷΪchunked
+	inline bool chunked() const {
+		return _chunked;
+	}
+	/// Content-Length
+	/// \return Content-Length,ûʱΪstring::npos
+	inline size_t content_length() const {
+		return _content_length;
+	}
+
+	/// Header
+	/// \return Header,trailer
+	inline size_t headers() const {
+		return _headers.size();
+	}
+	/// Header
+	string header_name( const size_t index ) const;
+	/// Headerֵ
+	string header_value( const size_t index ) const;
+	/// ָƵHeaderֵ
+	const char* header( const string &name, size_t &len ) const;
+	/// ָƵHeaderֵ
+	string header( const string &name ) const;
+
+	/// رͷԭ
+	/// \return ͷԭ,״̬м,trailer
+	inline const string& head() const {
+		return _head;
+	}
+	/// 
+	/// \return ,صʱΪַ
+	inline const string& body() const {
+		return _body;
+	}
+	/// 
+	/// ȡĶ
+	/// \param body ַ
+	inline void swap_body( string &body ) {
+		_body.swap( body );
+	}
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// ȡһ,з
+	bool getline( string &buffer, const char *data, const size_t len, size_t &pos, 
+		size_t &start, size_t &end );
+	/// Header
+	void parse_header( const string &buffer, const size_t start, const size_t end, 
+		const bool trailer );
+	/// ͷ
+	void end_header();
+	/// 
+	bool output( const char *data, const size_t len );
+	/// HeaderǷͬ
+	bool match( const size_t index, const string &name ) const;
+
+	typedef struct {					// Headerλ
+		size_t name;					// λ
+		size_t name_len;				// Ƴ
+		size_t value;					// ֵλ
+		size_t value_len;				// ֵ
+		bool trailer;					// ǷΪtrailer
+	} header_slice;
+
+	parse_state _state;					// ״̬
+	bool _head_request;					// ǷΪHEAD
+	size_t _received;					// ѷֽ
+	int _status;						// HTTP״̬
+	bool _http11;						// ǷΪHTTP/1.1
+	bool _keepalive;					// Ƿ񱣳
+	bool _chunked;						// ǷΪchunked
+	size_t _content_length;				// Content-Length
+	size_t _remain;						// ǰĻchunkʣ೤
+	size_t _line;						// ǰпʼλ
+
+	string _head;						// ͷԭ
+	string _trailer;					// trailerԭ
+	string _chunk;						// chunk
+	string _body;						// 
+	vector<header_slice> _headers;		// Headerλ
+
+	output_func _output;				// ص
+	void *_output_arg;					// ص
+};
+
 /// HTTPͻ
 /// <a href="wa_httpclient.html">ʹ˵ĵ򵥷</a>
 class HttpClient {
+	friend class MultiHttpClient;
+
 	public:
 	
 	/// \enum Ϣ
@@ -55,11 +366,24 @@ class HttpClient {
 		/// ӦHTTP״̬
 		ERROR_HTTPSTATUS			= 9,
 		/// δ֪
-		ERROR_UNKNOWN				= 10
+		ERROR_UNKNOWN				= 10,
+		/// ȴӳʱ,Ѵﵽӳ
+		ERROR_CONNECTION_LIMIT		= 11,
+		/// дʧ
+		ERROR_OUTPUT				= 12,
+		/// Ӧ߽ʧ
+		ERROR_RESPONSE_INCOMPLETE	= 13
 	};
 
+	/// ص
+	/// Ϊݡݳȡset_output()ʱָĲ,falseʱֹͣ
+	typedef bool (*output_func)( const char *data, const size_t len, void *arg );
+
 	/// ĬϹ캯
-	HttpClient(){};
+	HttpClient():
+	_errno(ERROR_NULL), _keepalive(false), 
+	_output(0), _output_arg(0), _output_fp(0)
+	{};
 	
 	/// 첢ִHTTP
 	/// \param url HTTPURL
@@ -68,13 +392,18 @@ class HttpClient {
 	/// \param method HTTPMethod,ĬΪ"GET"
 	/// \param timeout HTTPʱʱ,λΪ,ĬΪ5,Ϊ0жϳʱ
 	HttpClient( const string &url, const string &server = "", const int port = 80, 
-		const string &method = "GET", const int timeout = 5 ) 
+		const string &method = "GET", const int timeout = 5 ):
+	_errno(ERROR_NULL), _keepalive(false), 
+	_output(0), _output_arg(0), _output_fp(0)
 	{
 		this->request( url, server, port, method, timeout );
 	}
 		  
 	/// 
-	virtual ~HttpClient(){};
+	virtual ~HttpClient() {
+		if ( _output_fp != 0 )
+			fclose( _output_fp );
+	}
 
 	/// ָHTTPHeader
 	void set_header( const string &name, const string &value );
@@ -86,6 +415,12 @@ class HttpClient {
 	void set_cookie( const string &name, const string &value );
 	/// HTTPCGI
 	void set_param( const string &name, const string &value );
+	/// Ƿʹkeep-alive
+	void set_keepalive( const bool keepalive = true );
+	/// ص
+	void set_output( const output_func output, void *arg = 0 );
+	/// ļ
+	void set_output( const string &file );
 
 	/// ִHTTP
 	bool request( const string &url, const string &server = "", const int port = 80, 
@@ -111,8 +446,9 @@ class HttpClient {
 		return _status;
 	}
 	/// ȡHTTPContent
+	/// ʱΪַ
 	/// \return HTTPContent
-	inline string content() const {
+	inline const string& content() const {
 		return _content;
 	}
 	/// ȡHTTPContentĳ(Content-Length)
@@ -135,14 +471,26 @@ class HttpClient {
 		return _request;
 	}
 	/// õķȫ
+	/// Ϊ,ʱ
 	/// \return ػõķȫ
 	inline string dump_response() const {
-		return _response;
+		return _parser.head() + _content;
 	}
 	
 	////////////////////////////////////////////////////////////////////////////
 	private:
 
+	/// HTTP
+	bool prepare( const string &url, const string &server, const int port, 
+		const string &method, string &addr, int &addr_port );
+	/// ɵHTTP
+	bool finish();
+	/// ʼHTTP
+	void begin_response( const bool head );
+	/// յ
+	error_msg receive( const char *data, const size_t len, bool &complete );
+	/// ص
+	static bool parser_output( const char *data, const size_t len, void *client );
 	/// HTTP URLַ
 	void parse_url( const string &url, string &parsed_host, string &parsed_addr,
 		string &parsed_url, string &parsed_param, int &parsed_port );
@@ -150,9 +498,10 @@ class HttpClient {
 	string gen_httpreq( const string &url, const string &params,
 		const string &host, const string &method );
 	/// HTTP
-	void parse_response( const string &response );
-	/// HTTPchunkedcontent
-	string parse_chunked( const string &chunkedstr );
+	void parse_response();
+	/// HTTPȡûӦ
+	error_msg transfer( const string &addr, const int port, 
+		const bool head, const int timeout );
 	
 	// set		
 	String _request;			// generated request
@@ -160,12 +509,96 @@ class HttpClient {
 	map<string,string> _sets;	// push http headers
 
 	// get
-	String _response;			// server response
+	HttpResponseParser _parser;	// server response parser
 	String _status;				// http response status
 	String _content;			// http response content
 	map<string,string> _gets;	// recv http headers
 	
 	error_msg _errno;			// current error code
+	bool _keepalive;			// use keep-alive connection
+
+	// output
+	output_func _output;		// body output callback
+	void *_output_arg;			// body output callback arg
+	string _output_file;		// body output file
+	FILE *_output_fp;			// opened body output file
+
+	bool _reusable;				// connection reusable after response
+};
+
+/// HTTP
+/// ʹ÷socketepollͬʱִжHttpClient,ܺʱΪʱ,
+/// ڸԵHttpClient,Ҳÿʱûص
+class MultiHttpClient {
+	public:
+
+	/// ɻص
+	/// ΪšִHttpClientadd()ʱָĲ
+	typedef void (*callback_func)( const size_t index, HttpClient &client, void *arg );
+
+	/// 캯
+	MultiHttpClient(){};
+
+	/// 
+	virtual ~MultiHttpClient(){};
+
+	/// HTTP
+	size_t add( HttpClient &client, const string &url, const string &server = "", 
+		const int port = 80, const string &method = "GET", const int timeout = 5,
+		const callback_func callback = 0, void *arg = 0 );
+	/// ִHTTP
+	bool perform( const int deadline = 0 );
+
+	/// HTTP
+	/// \return HTTP
+	inline size_t size() const {
+		return _reqs.size();
+	}
+	/// HTTP
+	inline void clear() {
+		_reqs.clear();
+	}
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// \enum ״̬
+	enum multi_state {
+		MULTI_WAIT,						// ȴ
+		MULTI_CONNECT,					// 
+		MULTI_SEND,						// ڷ
+		MULTI_RECV,						// ڽջӦ
+		MULTI_DONE						// 
+	};
+
+	typedef struct {					// HTTP
+		HttpClient *client;				// ִHttpClient
+		string url;						// URL
+		string server;					// ַ
+		int port;						// ˿
+		string method;					// Method
+		int timeout;					// ʱʱ,λΪ
+		callback_func callback;			// ɻص
+		void *arg;						// ص
+		string addr;					// IP
+		int addr_port;					// Ӷ˿
+		int fd;							// socket
+		bool reused;					// ǷΪӳе
+		bool acquired;					// Ƿռӳ
+		size_t sent;					// ѷֽ
+		long long expire;				// ʱʱ,λΪ
+		multi_state state;				// ״̬
+	} multi_req;
+
+	/// ʼ
+	bool connect( const int epfd, multi_req &req );
+	/// socket¼
+	bool process( const int epfd, multi_req &req );
+	/// 
+	void complete( const size_t index, const HttpClient::error_msg error, const bool keepalive = false );
+
+	vector<multi_req> _reqs;			// HTTPб
+	vector<char> _buffer;				// ջ
 };
 
 } // namespace
@@ -0,0 +1,689 @@
+/// \file waJson.cpp
+/// webapp::Json,webapp::JsonValueʵļ
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "waJson.h"
+#ifndef _WEBAPPLIB_NOMYSQL
+#include "waMysqlClient.h"
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+/// Web Application Library namaspace
+namespace webapp {
+
+////////////////////////////////////////////////////////////////////////////
+// escape
+
+/// صһҪתַλ
+/// ҪתַΪ'"','\\'С0x20Ŀַ,
+/// ֧SSE2ʱÿμ16ֽ,ÿμ8ֽ
+/// \param p ʼλ
+/// \param end λ
+/// \return Ҫתַλ,û򷵻end
+static const char* json_escape_scan( const char *p, const char *end ) {
+	#ifdef __SSE2__
+	const __m128i quote = _mm_set1_epi8( '"' );
+	const __m128i slash = _mm_set1_epi8( '\\' );
+	const __m128i space = _mm_set1_epi8( 0x20 );
+	const __m128i sign = _mm_set1_epi8( static_cast<char>(0x80) );
+	const __m128i limit = _mm_xor_si128( space, sign );
+
+	while ( end-p >= 16 ) {
+		__m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) );
+		// unsigned v < 0x20: compare as signed after flipping sign bit
+		__m128i ctrl = _mm_cmplt_epi8( _mm_xor_si128(v,sign), limit );
+		__m128i hit = _mm_or_si128( ctrl, _mm_or_si128(
+			_mm_cmpeq_epi8(v,quote), _mm_cmpeq_epi8(v,slash)) );
+		int mask = _mm_movemask_epi8( hit );
+		if ( mask != 0 )
+			return p + __builtin_ctz( mask );
+		p += 16;
+	}
+	#else
+	const unsigned long long ones = 0x0101010101010101ULL;
+	const unsigned long long highs = 0x8080808080808080ULL;
+
+	while ( end-p >= 8 ) {
+		unsigned long long v;
+		memcpy( &v, p, 8 );
+		// has zero byte: (x-ones) & ~x & highs
+		unsigned long long q = v ^ ( ones*'"' );
+		unsigned long long s = v ^ ( ones*'\\' );
+		unsigned long long hit = ( (q-ones) & ~q ) | ( (s-ones) & ~s )
+			| ( (v-ones*0x20) & ~v );
+		if ( (hit&highs) != 0 )
+			break;
+		p += 8;
+	}
+	#endif
+
+	for ( ; p<end; ++p ) {
+		unsigned char c = *p;
+		if ( c<0x20 || c=='"' || c=='\\' )
+			return p;
+	}
+	return end;
+}
+
+/// \ingroup waJson
+/// \fn void json_escape( const char *str, const size_t len, string &output )
+/// JSONַת岢׷ӵַ
+/// ַת,ASCIIַ(GBK)ԭ
+/// \param str Դַ
+/// \param len Դַ
+/// \param output ַ
+void json_escape( const char *str, const size_t len, string &output ) {
+	const char *p = str;
+	const char *end = str + len;
+	const char *hit;
+	char hex[8];
+
+	while ( (hit=json_escape_scan(p,end)) != end ) {
+		output.append( p, hit-p );
+		switch ( *hit ) {
+			case '"':	output += "\\\"";	break;
+			case '\\':	output += "\\\\";	break;
+			case '\n':	output += "\\n";	break;
+			case '\r':	output += "\\r";	break;
+			case '\t':	output += "\\t";	break;
+			case '\b':	output += "\\b";	break;
+			case '\f':	output += "\\f";	break;
+			default:
+				snprintf( hex, sizeof(hex), "\\u%04x", static_cast<unsigned char>(*hit) );
+				output += hex;
+		}
+		p = hit + 1;
+	}
+	output.append( p, end-p );
+}
+
+/// \ingroup waJson
+/// \fn string json_escape( const string &str )
+/// JSONַת
+/// \param str Դַ
+/// \return תַ,
+string json_escape( const string &str ) {
+	string res;
+	res.reserve( str.length()+16 );
+	json_escape( str.c_str(), str.length(), res );
+	return res;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// Json
+
+/// ʼ
+/// \return 
+Json& Json::begin_object() {
+	this->separate();
+	_buf += '{';
+	_comma = false;
+	return *this;
+}
+
+/// 
+/// \return 
+Json& Json::end_object() {
+	_buf += '}';
+	_comma = true;
+	this->check_flush();
+	return *this;
+}
+
+/// ʼ
+/// \return 
+Json& Json::begin_array() {
+	this->separate();
+	_buf += '[';
+	_comma = false;
+	return *this;
+}
+
+/// 
+/// \return 
+Json& Json::end_array() {
+	_buf += ']';
+	_comma = true;
+	this->check_flush();
+	return *this;
+}
+
+/// Ա
+/// ֮һvalue()ȺԱֵ
+/// \param name Ա
+/// \return 
+Json& Json::key( const string &name ) {
+	this->separate();
+	_buf += '"';
+	json_escape( name.c_str(), name.length(), _buf );
+	_buf += "\":";
+	_comma = false;
+	return *this;
+}
+
+/// ֵַ
+/// \param val ַ
+/// \return 
+Json& Json::value( const string &val ) {
+	return this->value( val.c_str(), val.length() );
+}
+
+/// ֵַ
+/// \param val ַ,ΪNULLʱnull
+/// \return 
+Json& Json::value( const char *val ) {
+	if ( val == NULL )
+		return this->null();
+	return this->value( val, strlen(val) );
+}
+
+/// ֵַ
+/// \param val ַ
+/// \param len ַ
+/// \return 
+Json& Json::value( const char *val, const size_t len ) {
+	this->separate();
+	_buf += '"';
+	json_escape( val, len, _buf );
+	_buf += '"';
+	this->check_flush();
+	return *this;
+}
+
+/// ֵ
+/// \param val ֵ
+/// \return 
+Json& Json::value( const long val ) {
+	char num[32];
+	int len = snprintf( num, sizeof(num), "%ld", val );
+	this->separate();
+	_buf.append( num, len );
+	this->check_flush();
+	return *this;
+}
+
+/// ֵ
+/// 17λЧԱ֤,NaNЧJSONֵ,null
+/// \param val ֵ
+/// \return 
+Json& Json::value( const double val ) {
+	// NaN or infinity
+	if ( val-val != 0 )
+		return this->null();
+
+	char num[32];
+	int len = snprintf( num, sizeof(num), "%.17g", val );
+	this->separate();
+	_buf.append( num, len );
+	this->check_flush();
+	return *this;
+}
+
+/// ֵ
+/// \param val ֵ
+/// \return 
+Json& Json::value( const bool val ) {
+	this->separate();
+	_buf += val ? "true" : "false";
+	this->check_flush();
+	return *this;
+}
+
+/// nullֵ
+/// \return 
+Json& Json::null() {
+	this->separate();
+	_buf += "null";
+	this->check_flush();
+	return *this;
+}
+
+/// ѱJSONı
+/// \param json JSONı,κμԭ
+/// \return 
+Json& Json::raw( const string &json ) {
+	this->separate();
+	_buf += json;
+	this->check_flush();
+	return *this;
+}
+
+/// б,ʽΪ
+/// ݸʽTemplateѭͬ,
+/// [{"field_0":"value_0","field_1":"value_1",...},...]
+/// \param fields ֶб
+/// \param datas б,ÿֶʱֶֻ
+/// \return 
+Json& Json::rows( const vector<string> &fields, const vector< vector<string> > &datas ) {
+	this->begin_array();
+	for ( size_t i=0; i<datas.size(); ++i ) {
+		this->begin_object();
+		for ( size_t j=0; j<fields.size() && j<datas[i].size(); ++j ) {
+			this->key( fields[j] );
+			this->value( datas[i][j] );
+		}
+		this->end_object();
+	}
+	return this->end_array();
+}
+
+#ifndef _WEBAPPLIB_NOMYSQL
+/// MysqlDataݼ,ʽΪ
+/// ֱӶȡMYSQL_ROW,мַ,ֵֶΪNULLʱnull
+/// \param data MysqlDataݼ
+/// \return 
+Json& Json::rows( MysqlData &data ) {
+	this->begin_array();
+	if ( data._mysqlres != NULL ) {
+		// field names
+		vector<string> fields;
+		for ( size_t i=0; i<data.cols(); ++i )
+			fields.push_back( data.field_name(i) );
+
+		mysql_data_seek( data._mysqlres, 0 );
+		for ( size_t i=0; i<data.rows(); ++i ) {
+			MYSQL_ROW row = mysql_fetch_row( data._mysqlres );
+			unsigned long *lengths = mysql_fetch_lengths( data._mysqlres );
+			if ( row == NULL || lengths == NULL )
+				break;
+
+			this->begin_object();
+			for ( size_t j=0; j<fields.size(); ++j ) {
+				this->key( fields[j] );
+				if ( row[j] != NULL )
+					this->value( row[j], lengths[j] );
+				else
+					this->null();
+			}
+			this->end_object();
+		}
+
+		// restore MysqlData cursor
+		mysql_data_seek( data._mysqlres, 0 );
+		data._mysqlrow = mysql_fetch_row( data._mysqlres );
+		data._curpos = 0;
+		data._fetched = 0;
+	}
+	return this->end_array();
+}
+#endif //_WEBAPPLIB_NOMYSQL
+
+/// д
+/// δָʱκβ
+void Json::flush() {
+	if ( _output!=0 && _buf.length()>0 ) {
+		_output->write( _buf.data(), _buf.length() );
+		_buf.clear();
+	}
+}
+
+/// ״̬
+void Json::clear() {
+	_buf.clear();
+	_comma = false;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// JsonValue
+
+/// ȡ4λʮ
+/// \param p ʼλ
+/// \param code ֵ
+/// \retval true ɹ
+/// \retval false ʮַ
+static bool json_hex( const char *p, unsigned long &code ) {
+	code = 0;
+	for ( int i=0; i<4; ++i ) {
+		char c = p[i];
+		code <<= 4;
+		if ( c>='0' && c<='9' )
+			code |= c - '0';
+		else if ( c>='a' && c<='f' )
+			code |= c - 'a' + 10;
+		else if ( c>='A' && c<='F' )
+			code |= c - 'A' + 10;
+		else
+			return false;
+	}
+	return true;
+}
+
+/// UnicodeַUTF-8׷ӵַ
+/// \param code Unicodeַ
+/// \param res ַ
+static void json_utf8( const unsigned long code, string &res ) {
+	if ( code < 0x80 ) {
+		res += static_cast<char>( code );
+	} else if ( code < 0x800 ) {
+		res += static_cast<char>( 0xC0|(code>>6) );
+		res += static_cast<char>( 0x80|(code&0x3F) );
+	} else if ( code < 0x10000 ) {
+		res += static_cast<char>( 0xE0|(code>>12) );
+		res += static_cast<char>( 0x80|((code>>6)&0x3F) );
+		res += static_cast<char>( 0x80|(code&0x3F) );
+	} else {
+		res += static_cast<char>( 0xF0|(code>>18) );
+		res += static_cast<char>( 0x80|((code>>12)&0x3F) );
+		res += static_cast<char>( 0x80|((code>>6)&0x3F) );
+		res += static_cast<char>( 0x80|(code&0x3F) );
+	}
+}
+
+/// ʼ
+/// \param begin JSONıʼλ
+/// \param end JSONıλ
+void JsonValue::init( const char *begin, const char *end ) {
+	_key = 0;
+	_end = end;
+	_val = this->skip_blank( begin );
+	if ( _val >= _end )
+		_val = 0;
+}
+
+/// հַ
+/// \param p ʼλ
+/// \return һǿհַλ
+const char* JsonValue::skip_blank( const char *p ) const {
+	while ( p<_end && (*p==' '||*p=='\t'||*p=='\n'||*p=='\r') )
+		++p;
+	return p;
+}
+
+/// һֵ
+/// \param p ֵʼλ
+/// \return ֵ֮λ,ʽ󷵻_end
+const char* JsonValue::skip_value( const char *p ) const {
+	if ( p >= _end )
+		return _end;
+
+	if ( *p == '"' ) {
+		// string
+		for ( ++p; p<_end; ++p ) {
+			if ( *p == '\\' )
+				++p;
+			else if ( *p == '"' )
+				return p+1;
+		}
+		return _end;
+
+	} else if ( *p=='{' || *p=='[' ) {
+		// object or array, skip nested strings
+		int depth = 0;
+		for ( ; p<_end; ++p ) {
+			if ( *p == '"' ) {
+				p = this->skip_value( p ) - 1;
+			} else if ( *p=='{' || *p=='[' ) {
+				++depth;
+			} else if ( *p=='}' || *p==']' ) {
+				if ( --depth == 0 )
+					return p+1;
+			}
+		}
+		return _end;
+
+	} else {
+		// number, true, false, null
+		while ( p<_end && *p!=',' && *p!='}' && *p!=']'
+			&& *p!=' ' && *p!='\t' && *p!='\n' && *p!='\r' )
+			++p;
+		return p;
+	}
+}
+
+/// ֵ
+/// \return ֵ,μJsonValue::json_type
+JsonValue::json_type JsonValue::type() const {
+	if ( _val==0 || _val>=_end )
+		return JSON_INVALID;
+
+	switch ( *_val ) {
+		case '{':	return JSON_OBJECT;
+		case '[':	return JSON_ARRAY;
+		case '"':	return JSON_STRING;
+		case 't':
+		case 'f':	return JSON_BOOL;
+		case 'n':	return JSON_NULL;
+		default:
+			if ( *_val=='-' || (*_val>='0' && *_val<='9') )
+				return JSON_NUMBER;
+			return JSON_INVALID;
+	}
+}
+
+/// ĵһԪ
+/// \return һԪ,Ϊջ߲顢ʱЧֵ
+JsonValue JsonValue::child() const {
+	JsonValue res;
+	json_type t = this->type();
+	if ( t!=JSON_ARRAY && t!=JSON_OBJECT )
+		return res;
+
+	const char *p = this->skip_blank( _val+1 );
+	if ( p>=_end || *p==']' || *p=='}' )
+		return res;
+
+	res._end = _end;
+	if ( t == JSON_OBJECT ) {
+		// "name" : value
+		if ( *p != '"' )
+			return res;
+		res._key = p;
+		p = this->skip_blank( this->skip_value(p) );
+		if ( p>=_end || *p!=':' )
+			return JsonValue();
+		p = this->skip_blank( p+1 );
+	}
+	res._val = ( p<_end ) ? p : 0;
+	return res;
+}
+
+/// ͬһеһԪ
+/// \return һԪ,һʱЧֵ
+JsonValue JsonValue::next() const {
+	JsonValue res;
+	if ( _val == 0 )
+		return res;
+
+	const char *p = this->skip_blank( this->skip_value(_val) );
+	if ( p>=_end || *p!=',' )
+		return res;
+	p = this->skip_blank( p+1 );
+
+	res._end = _end;
+	if ( _key != 0 ) {
+		// "name" : value
+		if ( p>=_end || *p!='"' )
+			return JsonValue();
+		res._key = p;
+		p = this->skip_blank( this->skip_value(p) );
+		if ( p>=_end || *p!=':' )
+			return JsonValue();
+		p = this->skip_blank( p+1 );
+	}
+	res._val = ( p<_end ) ? p : 0;
+	return res;
+}
+
+/// ضԱ
+/// \param name Ա
+/// \return Աֵ,ڻ߲ǶʱЧֵ
+JsonValue JsonValue::operator[] ( const string &name ) const {
+	if ( this->type() != JSON_OBJECT )
+		return JsonValue();
+
+	for ( JsonValue i=this->child(); i.valid(); i=i.next() ) {
+		// compare raw key first, decode only if escaped
+		const char *k = i._key + 1;
+		const char *kend = this->skip_value( i._key ) - 1;
+		size_t klen = kend - k;
+		if ( memchr(k,'\\',klen) == NULL ) {
+			if ( klen==name.length() && memcmp(k,name.data(),klen)==0 )
+				return i;
+		} else if ( i.name() == name ) {
+			return i;
+		}
+	}
+	return JsonValue();
+}
+
+/// Ԫ
+/// \param index Ԫλ
+/// \return Ԫֵ,ڻ߲ʱЧֵ
+JsonValue JsonValue::operator[] ( const size_t index ) const {
+	if ( this->type() != JSON_ARRAY )
+		return JsonValue();
+
+	JsonValue i = this->child();
+	for ( size_t n=0; n<index && i.valid(); ++n )
+		i = i.next();
+	return i;
+}
+
+/// ضԱ
+/// \return Ա,ǶԱЧʱؿַ
+string JsonValue::name() const {
+	string res;
+	if ( _key != 0 )
+		this->decode( _key, res );
+	return res;
+}
+
+/// Ԫ
+/// \return Ԫ
+size_t JsonValue::size() const {
+	size_t n = 0;
+	for ( JsonValue i=this->child(); i.valid(); i=i.next() )
+		++n;
+	return n;
+}
+
+/// ֵַ
+/// תַ\\uXXXXUTF-8,ַַת
+/// \return ֵַ,ֵ벼ֵı,
+/// null顢ЧֵЧתַַؿַ
+string JsonValue::str() const {
+	string res;
+	switch ( this->type() ) {
+		case JSON_STRING:
+			if ( !this->decode(_val,res) )
+				res.clear();
+			return res;
+		case JSON_NUMBER:
+		case JSON_BOOL:
+			return this->raw();
+		default:
+			return string( "" );
+	}
+}
+
+/// ֵ
+/// \return ֵ,ַʱת,ͷ0
+long JsonValue::integer() const {
+	json_type t = this->type();
+	if ( t == JSON_NUMBER )
+		return strtol( this->raw().c_str(), NULL, 10 );
+	else if ( t == JSON_STRING )
+		return strtol( this->str().c_str(), NULL, 10 );
+	else if ( t == JSON_BOOL )
+		return this->boolean() ? 1 : 0;
+	return 0;
+}
+
+/// ظֵ
+/// \return ֵ,ַʱת,ͷ0
+double JsonValue::number() const {
+	json_type t = this->type();
+	if ( t == JSON_NUMBER )
+		return strtod( this->raw().c_str(), NULL );
+	else if ( t == JSON_STRING )
+		return strtod( this->str().c_str(), NULL );
+	else if ( t == JSON_BOOL )
+		return this->boolean() ? 1 : 0;
+	return 0;
+}
+
+/// زֵ
+/// \return ֵ,true0ֵtrue,false
+bool JsonValue::boolean() const {
+	json_type t = this->type();
+	if ( t == JSON_BOOL )
+		return ( *_val == 't' );
+	else if ( t == JSON_NUMBER )
+		return ( this->number() != 0 );
+	return false;
+}
+
+/// ԭʼJSONı
+/// \return ֵԭʼJSONı,Чֵؿַ
+string JsonValue::raw() const {
+	if ( !this->valid() )
+		return string( "" );
+	return string( _val, this->skip_value(_val)-_val );
+}
+
+/// ַ
+/// תַ\\uXXXXUTF-8,UTF-16ԺϲΪһַ,
+/// ַַת,ASCIIַ(GBK)ԭ
+/// \param p ַʼλ(λ)
+/// \param res ؽַ
+/// \retval true ɹ
+/// \retval false ַδ,߰ЧתַɶԵUTF-16
+bool JsonValue::decode( const char *p, string &res ) const {
+	res.clear();
+	if ( p>=_end || *p!='"' )
+		return false;
+
+	++p;
+	while ( p < _end ) {
+		const char *q = p;
+		while ( q<_end && *q!='"' && *q!='\\' )
+			++q;
+		res.append( p, q-p );
+		if ( q>=_end || *q=='"' )
+			return q < _end;
+
+		p = q + 1;
+		if ( p >= _end )
+			return false;
+
+		switch ( *p ) {
+			case 'n':	res += '\n';	break;
+			case 'r':	res += '\r';	break;
+			case 't':	res += '\t';	break;
+			case 'b':	res += '\b';	break;
+			case 'f':	res += '\f';	break;
+			case '"':
+			case '\\':
+			case '/':	res += *p;		break;
+			case 'u': {
+				unsigned long c;
+				if ( _end-p<5 || !json_hex(p+1,c) || (c>=0xDC00 && c<=0xDFFF) )
+					return false;
+				p += 4;
+				if ( c>=0xD800 && c<=0xDBFF ) {
+					// surrogate pair
+					unsigned long low;
+					if ( _end-p<7 || p[1]!='\\' || p[2]!='u' || !json_hex(p+3,low)
+						|| low<0xDC00 || low>0xDFFF )
+						return false;
+					c = 0x10000 + ( (c-0xD800)<<10 ) + ( low-0xDC00 );
+					p += 6;
+				}
+				json_utf8( c, res );
+				}
+				break;
+			default:
+				return false;
+		}
+		++p;
+	}
+	return false;
+}
+
+} // namespace
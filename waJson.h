@@ -0,0 +1,247 @@
+/// \file waJson.h
+/// webapp::Json,webapp::JsonValueͷļ
+/// JSON밴
+///  webapp::String
+
+#ifndef _WEBAPPLIB_JSON_H_
+#define _WEBAPPLIB_JSON_H_
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "waString.h"
+
+using namespace std;
+
+/// Web Application Library namaspace
+namespace webapp {
+
+#ifndef _WEBAPPLIB_NOMYSQL
+class MysqlData;
+#endif
+
+/// \defgroup waJson waJsonȫֺ
+
+/// JSONַת岢׷ӵַ
+void json_escape( const char *str, const size_t len, string &output );
+/// JSONַת
+string json_escape( const string &str );
+
+/// JSON
+/// ֱ׷д,ָʱﵽֵд
+class Json {
+	public:
+
+	/// 캯,ڻ
+	/// \param reserve ԤС,ĬΪ1024
+	Json( const size_t reserve = 1024 ):
+	_output(0), _flush_size(0), _comma(false)
+	{
+		_buf.reserve( reserve );
+	}
+
+	/// 캯,д
+	/// \param output 
+	/// \param flush_size дֵ,ĬΪ8192
+	Json( ostream &output, const size_t flush_size = 8192 ):
+	_output(&output), _flush_size(flush_size), _comma(false)
+	{
+		_buf.reserve( flush_size+256 );
+	}
+
+	/// 
+	virtual ~Json() {
+		this->flush();
+	}
+
+	/// ʼ
+	Json& begin_object();
+	/// 
+	Json& end_object();
+	/// ʼ
+	Json& begin_array();
+	/// 
+	Json& end_array();
+
+	/// Ա
+	Json& key( const string &name );
+
+	/// ֵַ
+	Json& value( const string &val );
+	/// ֵַ
+	Json& value( const char *val );
+	/// ֵַ
+	Json& value( const char *val, const size_t len );
+	/// ֵ
+	Json& value( const long val );
+	/// ֵ
+	/// \param val ֵ
+	inline Json& value( const int val ) {
+		return this->value( static_cast<long>(val) );
+	}
+	/// ֵ
+	/// \param val ֵ
+	inline Json& value( const size_t val ) {
+		return this->value( static_cast<long>(val) );
+	}
+	/// ֵ
+	Json& value( const double val );
+	/// ֵ
+	Json& value( const bool val );
+	/// nullֵ
+	Json& null();
+	/// ѱJSONı
+	Json& raw( const string &json );
+
+	/// Ա
+	/// \param name Ա
+	/// \param val Աֵ
+	template <typename T>
+	inline Json& member( const string &name, const T &val ) {
+		this->key( name );
+		return this->value( val );
+	}
+
+	/// б,ʽΪ
+	Json& rows( const vector<string> &fields, const vector< vector<string> > &datas );
+
+	#ifndef _WEBAPPLIB_NOMYSQL
+	/// MysqlDataݼ,ʽΪ
+	Json& rows( MysqlData &data );
+	#endif
+
+	/// д
+	void flush();
+	/// ״̬
+	void clear();
+
+	/// 
+	/// \return ػеJSONı,ָʱΪδдĲ
+	inline const string& str() const {
+		return _buf;
+	}
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// ֵ֮ǰķָ
+	inline void separate() {
+		if ( _comma ) _buf += ',';
+		_comma = true;
+	}
+	/// ﵽֵʱд
+	inline void check_flush() {
+		if ( _output!=0 && _buf.length()>=_flush_size )
+			this->flush();
+	}
+
+	string _buf;			// output buffer
+	ostream *_output;		// output stream, 0 if none
+	size_t _flush_size;		// flush threshold
+	bool _comma;			// value written at current level
+};
+
+/// JSON
+/// ָֻԭʼJSONıָ,ʱɨ貿,ҲԤȽĵ,
+/// ԭʼJSONıJsonValueʹڼ뱣Ч
+class JsonValue {
+	public:
+
+	/// \enum JSONֵ
+	enum json_type {
+		/// Чֵ򲻴
+		JSON_INVALID,
+		/// null
+		JSON_NULL,
+		/// truefalse
+		JSON_BOOL,
+		/// ֵ
+		JSON_NUMBER,
+		/// ַ
+		JSON_STRING,
+		/// 
+		JSON_ARRAY,
+		/// 
+		JSON_OBJECT
+	};
+
+	/// ĬϹ캯,Чֵ
+	JsonValue():
+	_key(0), _val(0), _end(0)
+	{};
+
+	/// 캯
+	/// \param json JSONı,JsonValueʹڼ뱣Ч
+	JsonValue( const string &json ) {
+		this->init( json.c_str(), json.c_str()+json.length() );
+	}
+
+	/// 캯
+	/// \param begin JSONıʼλ
+	/// \param end JSONıλ
+	JsonValue( const char *begin, const char *end ) {
+		this->init( begin, end );
+	}
+
+	/// 
+	virtual ~JsonValue(){};
+
+	/// ֵ
+	json_type type() const;
+	/// ǷЧֵ
+	/// \retval true Ч
+	/// \retval false Ч򲻴
+	inline bool valid() const {
+		return this->type() != JSON_INVALID;
+	}
+
+	/// ضԱ
+	JsonValue operator[] ( const string &name ) const;
+	/// Ԫ
+	JsonValue operator[] ( const size_t index ) const;
+	/// Ԫ
+	/// \param index Ԫλ
+	inline JsonValue operator[] ( const int index ) const {
+		return (*this)[static_cast<size_t>(index)];
+	}
+
+	/// ĵһԪ
+	JsonValue child() const;
+	/// ͬһеһԪ
+	JsonValue next() const;
+	/// ضԱ
+	string name() const;
+	/// Ԫ
+	size_t size() const;
+
+	/// ֵַ,ֵ벼ֵı
+	string str() const;
+	/// ֵ
+	long integer() const;
+	/// ظֵ
+	double number() const;
+	/// زֵ
+	bool boolean() const;
+	/// ԭʼJSONı
+	string raw() const;
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// ʼ
+	void init( const char *begin, const char *end );
+	/// հַ
+	const char* skip_blank( const char *p ) const;
+	/// һֵ,ֵ֮λ
+	const char* skip_value( const char *p ) const;
+	/// ַ
+	bool decode( const char *p, string &res ) const;
+
+	const char *_key;		// member name, 0 if not object member
+	const char *_val;		// value begin
+	const char *_end;		// document end
+};
+
+} // namespace
+
+#endif //_WEBAPPLIB_JSON_H_
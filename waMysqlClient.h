@@ -31,6 +31,8 @@ string escape_sql( const string &str );
 /// MySQLݼ
 class MysqlData {
 	friend class MysqlClient;
+	friend class Json;
+	friend class MysqlRows;
 	
 	protected:
 	
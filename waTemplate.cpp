@@ -9,7 +9,17 @@
 #include <sstream>
 #include <iterator>
 #include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "waJson.h"
 #include "waTemplate.h"
+#ifndef _WEBAPPLIB_NOMYSQL
+#include "waMysqlClient.h"
+#endif
 
 using namespace std;
 
@@ -17,191 +27,107 @@ using namespace std;
 namespace webapp {
 	
 ////////////////////////////////////////////////////////////////////////////
-// set functions
-
-/// ȡHTMLģļ
-/// \param tmpl_file ģ·ļ
-/// \retval true ȡɹ
-/// \retval false ʧ
-bool Template::load( const string &tmpl_file ) {
-	if ( _tmpl.load_file(tmpl_file) ) {
-		_tmplfile = tmpl_file;
-		return true;
-	} else {
-		_tmplfile = "Error: Can't open file " + tmpl_file;
-		this->error_log( 0, _tmplfile );
-		return false;
-	}
+// symbol functions
+
+/// Ʊ,Ʋʱ
+/// ֻڱģʱ
+/// \param name 
+/// \return Ʊ
+int TemplateSymbol::id( const string &name ) {
+	map<string,int>::const_iterator i = _ids.find( name );
+	if ( i != _ids.end() )
+		return i->second;
+
+	int id = _names.size();
+	_ids[name] = id;
+	_names.push_back( name );
+	return id;
 }
 
-/// HTMLģ
-/// \param tmpl ģַ
-void Template::tmpl( const string &tmpl ) {
-	_tmplfile = "Read from string";
-	_tmpl = tmpl;
+/// Ʊ
+/// \param name 
+/// \return Ʊ,Ʋڷ-1
+int TemplateSymbol::find( const string &name ) const {
+	map<string,int>::const_iterator i = _ids.find( name );
+	if ( i != _ids.end() )
+		return i->second;
+	return -1;
 }
 
-/// 滻
-/// \param name ģ
-/// \param value 滻ֵ
-void Template::set( const string &name, const string &value ) {
-	if ( name != "" )
-		_sets[name] = value;
+/// رŶӦ
+/// \param id Ʊ
+/// \return ,Ųڷؿַ
+const string& TemplateSymbol::name( const int id ) const {
+	static const string empty;
+	if ( id>=0 && static_cast<size_t>(id)<_names.size() )
+		return _names[id];
+	return empty;
 }
 
-/// ½ѭ
-/// \param loop ѭ
-/// \param field_0 field_0field_0֮Ϊֶб,һNULL
-/// \param ... ֶб,һNULL
-void Template::def_loop( const string &loop, const char* field_0, ... ) {
-	va_list ap;
-	const char *p;
-	string field;
-	strings fields;
-	size_t cols = 0;
-	
-	// check same name loop
-	if ( _loops.find(loop) != _loops.end() )
-		this->error_log( 0, "Warning: loop name \""+loop+"\" redefined" );
-	
-	// get fields
-	va_start( ap, field_0 );
-	for ( p=field_0; p; p=va_arg(ap,const char*) ) {
-		if ( (field=p) != "" ) {
-			fields.push_back( field );
-			_loops[loop].fieldspos[field] = cols; // for speed
-			++cols;
-		}
-	}
-	va_end( ap );
-
-	// for waTemplate old version templet script ( < v0.7 )
-	if ( _sets.find(loop) == _sets.end() )
-		set( loop, loop );
-
-	// init loop
-	_loops[loop].fields = fields;
-	for ( size_t i=0; i<_loops[loop].datas.size(); ++i )
-		_loops[loop].datas[i].clear();
-	_loops[loop].datas.clear();
-	_loops[loop].cursor = 0;
-	_loops[loop].rows = 0;
-	_loops[loop].cols = cols;
+////////////////////////////////////////////////////////////////////////////
+// compile functions
+
+/// Ƚַ
+/// strcmp()ͬ,'\0',ַ
+/// \param lhs ַʼλ
+/// \param llen ַ
+/// \param rhs Ҳַʼλ
+/// \param rlen Ҳַ
+/// \return Сڷظ,ȷ0,ڷ
+static int tmpl_strcmp( const char *lhs, size_t llen, const char *rhs, size_t rlen ) {
+	llen = strnlen( lhs, llen );
+	rlen = strnlen( rhs, rlen );
+	int res = memcmp( lhs, rhs, min(llen,rlen) );
+	if ( res == 0 )
+		res = ( llen>rlen ) ? 1 : ( llen==rlen ) ? 0 : -1;
+	return res;
 }
 
-/// һݵѭ
-/// ȵTemplate::def_loop()ʼѭֶζ,ֹ
-/// \param loop ѭ
-/// \param value_0 value_0value_0֮Ϊֶб,һNULL
-/// \param ... ֶб,һNULL
-void Template::append_row( const string &loop, const char* value_0, ... ) {
-	// loop must exist
-	if ( _loops.find(loop) == _loops.end() ) {
-		this->error_log( 0, "Error: Call def_loop() to init $"+loop+" first, in append_row()" );
-		return;
-	}
-	
-	// get values
-	va_list ap;
-	const char *p;
-	string value;
-	strings values;
-	int cols = 0;
-	
-	va_start( ap, value_0 );
-	for ( p=value_0; p; p=va_arg(ap,const char*) ) {
-		value = p;
-		values.push_back( value );
-		++cols;
-		
-		// enough now
-		if ( cols >= _loops[loop].cols )
-			break;
-	}
-	va_end( ap );
-
-	// fill blank if not enough
-	if( cols < _loops[loop].cols ) {
-		for ( int i=cols; i<_loops[loop].cols; ++i )
-			values.push_back( "" );
-	}
-	
-	// insert into loop
-	_loops[loop].datas.push_back( values );
-	++_loops[loop].rows;
+/// ļĿ¼
+/// \param file ļ·
+/// \return Ŀ¼,Ŀ¼ʱ"."
+static string tmpl_dirname( const string &file ) {
+	size_t pos = file.rfind( "/" );
+	if ( pos == file.npos )
+		return ".";
+	else if ( pos == 0 )
+		return "/";
+	else
+		return file.substr( 0, pos );
 }
 
-/// һָʽݵѭ
-/// ȵTemplate::def_loop()ʼѭֶζ,ֹ
-/// \param loop ѭ
-/// \param format ֶѭʽ,"%d,%s,..."ʽ
-/// \param ... Ϊֵֶб,
-/// ֵֶڸʽformatָĸ
-void Template::append_format( const string &loop, const char* format, ... ) {
-	// loop must exist
-	if ( _loops.find(loop) == _loops.end() ) {
-		this->error_log( 0, "Error: Call def_loop() to init $"+loop+" first, in append_format()" );
-		return;
-	}
-	
-	// split format string
-	String fmtstr = format;
-	vector<String> fmtlist = fmtstr.split( TMPL_SPLIT );
-	
-	// get values
-	va_list ap;
-	string value;
-	strings values;
-	int cols = 0;
-	
-	va_start( ap, format );
-	for ( size_t i=0; i<fmtlist.size(); ++i ) {
-		// read
-		fmtlist[i].trim();
-		if ( fmtlist[i] == TMPL_FMTSTR )
-			value = va_arg( ap, const char* ); // %s
-		else
-			value = itos( va_arg(ap,long) ); // %d or other
-			
-		// push data
-		values.push_back( value );
-		++cols;
+/// ļ
+/// \param file ļ·
+/// \return Ŀ¼ļ
+static string tmpl_basename( const string &file ) {
+	size_t pos = file.rfind( "/" );
+	return ( pos!=file.npos ) ? file.substr(pos+1) : file;
+}
 
-		// enough now
-		if ( cols >= _loops[loop].cols )
-			break;
+/// ַǷΪֲת
+/// String::isnum()strtol()ͬ,ַ
+/// \param str ַʼλ
+/// \param len ַ
+/// \param num ֵ
+/// \retval true ַΪ
+/// \retval false 
+static bool tmpl_number( const char *str, const size_t len, long &num ) {
+	if ( len == 0 )
+		return false;
+	for ( size_t i=0; i<len; ++i ) {
+		if ( !isdigit(str[i]) )
+			return false;
 	}
-	va_end( ap );
 
-	// fill blank if not enough
-	if( cols < _loops[loop].cols ) {
-		for ( int i=cols; i<_loops[loop].cols; ++i )
-			values.push_back( "" );
+	if ( len < 10 ) {
+		// no overflow
+		num = 0;
+		for ( size_t i=0; i<len; ++i )
+			num = num*10 + ( str[i]-'0' );
+	} else {
+		num = strtol( string(str,len).c_str(), 0, 10 );
 	}
-	
-	// insert into loop
-	_loops[loop].datas.push_back( values );
-	++_loops[loop].rows;
-}
-
-/// 滻
-/// ѭ滻
-void Template::clear_set() {
-	_sets.clear();
-	_loops.clear();
-}
-
-////////////////////////////////////////////////////////////////////////////
-// parse functions
-
-/// ֶλ
-/// \param loop ѭ
-/// \param field ֶ
-/// \return ҵֶλ,򷵻-1
-int Template::field_pos( const string &loop, const string &field ) {
-	if ( _loops[loop].fieldspos.find(field) == _loops[loop].fieldspos.end() )
-		return -1;
-	return _loops[loop].fieldspos[field];
+	return true;
 }
 
 /// ȡָλõģűͼʽ
@@ -210,7 +136,7 @@ int Template::field_pos( const string &loop, const string &field ) {
 /// \param exp ȡıʽַ
 /// \param type Ľű
 /// \return ֵΪηַ,-1
-int Template::parse_script( const string &tmpl, const size_t pos, 
+int CompiledTemplate::parse_script( const string &tmpl, const size_t pos, 
 	string &exp, int &type ) 
 {
 	// find TMPL_END
@@ -285,6 +211,26 @@ int Template::parse_script( const string &tmpl, const size_t pos,
 		// blank string: %BLANK
 		type = TMPL_S_BLANK;
 	
+	} else if ( strcmp(content.c_str(),TMPL_FLUSH) == 0 ) {
+		// flush output: #FLUSH
+		type = TMPL_S_FLUSH;
+	
+	} else if ( strncmp(content.c_str(),TMPL_CACHE,TMPL_CACHE_LEN) == 0 ) {
+		// cache begin: #CACHE key ttl
+		type = TMPL_S_CACHE;
+		content = content.substr( TMPL_CACHE_LEN );
+		content.trim();
+	
+	} else if ( strcmp(content.c_str(),TMPL_ENDCACHE) == 0 ) {
+		// cache end: #ENDCACHE
+		type = TMPL_S_ENDCACHE;
+	
+	} else if ( strncmp(content.c_str(),TMPL_INCLUDE,TMPL_INCLUDE_LEN) == 0 ) {
+		// include file: #INCLUDE file
+		type = TMPL_S_INCLUDE;
+		content = content.substr( TMPL_INCLUDE_LEN );
+		content.trim();
+	
 	} else {
 		type = TMPL_S_UNKNOWN;
 	}
@@ -294,736 +240,3559 @@ int Template::parse_script( const string &tmpl, const size_t pos,
 	return ( end-pos+TMPL_END_LEN );
 }
 
-/// ʽֵ
+/// ָ
+/// ڵģıϲΪһָ
+/// \param type ű
+/// \param pos ģıʼλ
+/// \param len ģı
+/// \param exp űʽ
+/// \param line ģ
+/// \return ָλ
+size_t CompiledTemplate::append( const int type, const size_t pos, const size_t len,
+	const string &exp, const int line )
+{
+	// merge text
+	if ( type==TMPL_S_TEXT && !_code.empty() ) {
+		tmpl_inst &last = _code.back();
+		if ( last.type==TMPL_S_TEXT && last.pos+last.len==pos ) {
+			last.len += len;
+			return _code.size()-1;
+		}
+	}
+
+	tmpl_inst inst;
+	inst.type = type;
+	inst.pos = pos;
+	inst.len = len;
+	inst.exp = exp;
+	inst.jump = 0;
+	inst.end = 0;
+	inst.line = line;
+	inst.val = -1;
+	inst.cond = -1;
+	inst.ttl = 0;
+
+	// resolve names
+	switch ( type ) {
+		case TMPL_S_VALUE:
+		case TMPL_S_LOOPVALUE:
+		case TMPL_S_CURSOR:
+		case TMPL_S_ROWS:
+		case TMPL_S_DATE:
+		case TMPL_S_TIME:
+		case TMPL_S_SPACE:
+		case TMPL_S_BLANK:
+			inst.val = this->compile_value( exp );
+			break;
+		case TMPL_S_LOOP:
+			inst.val = this->compile_scope( exp );
+			break;
+		case TMPL_S_IF:
+		case TMPL_S_ELSIF:
+			inst.cond = this->compile_cond( exp, line );
+			break;
+		case TMPL_S_CACHE: {
+			// key and optional ttl
+			String key = exp;
+			size_t pos = key.find_last_of( " \t" );
+			if ( pos != key.npos ) {
+				String ttl = key.substr( pos+1 );
+				if ( ttl.isnum() ) {
+					inst.ttl = atoi( ttl.c_str() );
+					key.erase( pos );
+					key.trim();
+				}
+			}
+			inst.val = this->compile_value( key );
+			}
+			break;
+	}
+
+	_code.push_back( inst );
+	return _code.size()-1;
+}
+
+/// ʽ
+/// ֶתΪƱ
 /// \param exp ʽַ
-/// \return ֵΪñʽֵ,ʽǷ򷵻رʽַ
-string Template::exp_value( const string &exp ) {
+/// \return ʽбλ
+int CompiledTemplate::compile_value( const string &exp ) {
+	tmpl_value val;
+	val.slot = -1;
+	val.scope = -1;
+	val.isnum = false;
+	val.num = 0;
+
 	if ( strncmp(exp.c_str(),TMPL_VALUE,TMPL_VALUE_LEN) == 0 ) {
 		// simple value: $xxx
-		string val = exp.substr( TMPL_VALUE_LEN );
-		return _sets[val];
+		val.type = TMPL_S_VALUE;
+		val.slot = _symbols->id( exp.substr(TMPL_VALUE_LEN) );
 		
 	} else if ( strncmp(exp.c_str(),TMPL_LOOPVALUE,TMPL_LOOPVALUE_LEN) == 0 ) {
 		// current value in loop: .$xxx
-		string val = exp.substr( TMPL_LOOPVALUE_LEN );
-		return this->loop_value( val );
+		val.type = TMPL_S_LOOPVALUE;
+		string field = exp.substr( TMPL_LOOPVALUE_LEN );
+		size_t pos = field.find( TMPL_LOOPSCOPE );
+		if ( pos != field.npos ) {
+			val.scope = this->compile_scope( field.substr(pos+TMPL_LOOPSCOPE_LEN) );
+			field.erase( pos );
+		}
+		val.slot = _symbols->id( field );
 		
-	} else if ( strncmp(exp.c_str(),TMPL_CURSOR,TMPL_CURSOR_LEN) == 0 ) {
+	} else if ( strncmp(exp.c_str(),TMPL_CURSOR,TMPL_CURSOR_LEN) == 0 ||
+				strncmp(exp.c_str(),TMPL_ROWS,TMPL_ROWS_LEN) == 0 ) {
 		// current loop cursor: %CURSOR
+		// current loop rows: %ROWS
+		val.type = ( exp[1]==TMPL_CURSOR[1] ) ? TMPL_S_CURSOR : TMPL_S_ROWS;
 		size_t pos = exp.find( TMPL_LOOPSCOPE );
-		if ( pos != exp.npos ) {
-			string loop_name = this->exp_value( exp.substr(pos+TMPL_LOOPSCOPE_LEN) );
-			int cursor = _loops[loop_name].cursor;
-			return itos(cursor+1);
-		} else {
-			return itos(_cursor+1);
-		}
+		if ( pos != exp.npos )
+			val.scope = this->compile_scope( exp.substr(pos+TMPL_LOOPSCOPE_LEN) );
 	
-	} else if ( strncmp(exp.c_str(),TMPL_ROWS,TMPL_ROWS_LEN) == 0 ) {
-		// current loop cursor: %ROWS
-		size_t pos = exp.find( TMPL_LOOPSCOPE );
-		if ( pos != exp.npos ) {
-			string loop_name = this->exp_value( exp.substr(pos+TMPL_LOOPSCOPE_LEN) );
-			return itos( _loops[loop_name].rows );
-		} else {
-			return itos( _loops[_loop].rows );
-		}
-
 	} else if ( strcmp(exp.c_str(),TMPL_DATE) == 0 ) {
 		// date: %DATE
-		return _date;
+		val.type = TMPL_S_DATE;
 	
 	} else if ( strcmp(exp.c_str(),TMPL_TIME) == 0 ) {
 		// time: %TIME
-		return _time;
+		val.type = TMPL_S_TIME;
 	
 	} else if ( strcmp(exp.c_str(),TMPL_SPACE) == 0 ) {
 		// space char: %SPACE
-		return " ";
+		val.type = TMPL_S_TEXT;
+		val.text = " ";
 	
 	} else if ( strcmp(exp.c_str(),TMPL_BLANK) == 0 ) {
 		// blank string: %BLANK
-		return "";
+		val.type = TMPL_S_TEXT;
 	
 	} else  {
-		// string
-		return exp;
-	}
-}
-
-/// ģ
-/// \param tmpl ģַ
-/// \param output 
-void Template::parse( const string &tmpl, ostream &output ) {
-	// init datetime
-	struct tm stm;
-	time_t tt = time( 0 );
-	localtime_r( &tt, &stm );
-	snprintf( _date, 15, "%d-%d-%d", stm.tm_year+1900, stm.tm_mon+1, stm.tm_mday );
-	snprintf( _time, 15, "%d:%d:%d", stm.tm_hour, stm.tm_min, stm.tm_sec );
-
-	// confirm if inited
-	if ( _tmpl == "" ) {
-		this->error_log( 0, "Error: Templet not initialized" );
-		return;
+		// string, numeric literal parsed here
+		val.type = TMPL_S_TEXT;
+		val.text = exp;
+		val.isnum = tmpl_number( exp.data(), exp.length(), val.num );
 	}
-	
-	// parse init
-	_loop = "";
-	_cursor = 0;
-	_lines = 0;
-	
-	size_t lastpos = 0;
-	size_t currpos = 0;
-
-	// for parse_script()
-	string exp;
-	int type;
-	int parsed;
-	
-	// search TMPL_BEGIN in tmpl
-	while( (currpos=tmpl.find(TMPL_BEGIN,lastpos)) != tmpl.npos ) {
-		// output html before TMPL_BEGIN
-		output << tmpl.substr( lastpos, currpos-lastpos );
-		
-		// log current position
-		if ( _debug == TMPL_OUTPUT_DEBUG ) {
-			String orightml = tmpl.substr( lastpos, currpos-lastpos );
-			_lines += orightml.count( TMPL_NEWLINE );
-		}
-		
-		// get script content between TMPL_BEGIN and TMPL_END
-		parsed = this->parse_script( tmpl, currpos, exp, type );
-		
-		if ( parsed < 0 ) {
-			// can't find TMPL_END
-			lastpos = currpos;
-			this->error_log( _lines, "Error: Can't find TMPL_END" );
-			break;
-		}
-		
-		// parse by script type
-		switch ( type ) {
-			case TMPL_S_VALUE:
-				// replace
-			case TMPL_S_DATE:
-				// replace with date
-			case TMPL_S_TIME:
-				// replace with time
-			case TMPL_S_SPACE:
-				// replace with space char
-			case TMPL_S_BLANK:
-				// replace with blank string
-				output << this->exp_value( exp );
-				break;
-
-			case TMPL_S_IF:
-				// condition replace
-				parsed = this->parse_if( tmpl.substr(currpos), output, true, exp, parsed );
-				break;
-				
-			case TMPL_S_LOOP:
-				// cycle replace
-				parsed = this->parse_loop( tmpl.substr(currpos), output, true, exp, parsed );
-				// restore loop status
-				_loop = "";
-				_cursor = 0;
-				break;
 
-			case TMPL_S_UNKNOWN:
-				// unknown script, maybe html code
-				this->error_log( _lines, "Warning: Unknown script, in parse()" );
-				
-				// for syntax error
-				size_t backlen;
-				if ( (backlen=exp.find(TMPL_BEGIN)) != exp.npos )
-					parsed = backlen+TMPL_BEGIN_LEN;
-					
-				output << tmpl.substr( currpos, parsed );
-				break;
-				
-			default:
-				// syntax error
-				this->error_log( _lines, "Error: Unexpected script, in parse()" );
-		}
+	_values.push_back( val );
+	return _values.size()-1;
+}
 
-		// location to next position
-		lastpos = currpos + parsed;
-	}
-	
-	// output tail html
-	output << tmpl.substr( lastpos );
+/// ѭƱʽ
+/// ѭΪַʱֱתΪƱ
+/// \param exp ѭƱʽַ
+/// \return ʽбλ
+int CompiledTemplate::compile_scope( const string &exp ) {
+	int val = this->compile_value( exp );
+	if ( _values[val].type == TMPL_S_TEXT )
+		_values[val].slot = _symbols->id( _values[val].text );
+	return val;
 }
 
-/// ʽǷ
-/// \param exp Ϊʽ,
-/// ʽΪַ,ֵΪ""ҲΪ"0"ʱtrue,򷵻false,
-/// ΪȽϱʽ,true,򷵻false
-/// \retval true ʽ
-/// \retval false ʽ
-bool Template::compare( const string &exp ) {
+/// Ƚϱʽ
+/// \param exp Ƚϱʽַ
+/// \return Ƚϱʽṹ
+CompiledTemplate::tmpl_cmp CompiledTemplate::compile_cmp( const string &exp ) {
 	// read compare type
 	// supported: ==,!=,<=,<,>=,>
-	string cmpop;
+	tmpl_cmp cmp;
 	size_t oppos;
-	tmpl_cmptype optype;
-	
+	size_t oplen;
+
 	if ( (oppos=exp.find(TMPL_EQ)) != exp.npos ) {
 		// ==
-		cmpop = TMPL_EQ;
-		optype = TMPL_C_EQ;
+		cmp.op = TMPL_C_EQ;
+		oplen = TMPL_EQ_LEN;
 	
 	} else if ( (oppos=exp.find(TMPL_NE)) != exp.npos ) {
 		// !=
-		cmpop = TMPL_NE;
-		optype = TMPL_C_NE;
+		cmp.op = TMPL_C_NE;
+		oplen = TMPL_NE_LEN;
 	
 	} else if ( (oppos=exp.find(TMPL_LE)) != exp.npos ) {
 		// <=
-		cmpop = TMPL_LE;
-		optype = TMPL_C_LE;
+		cmp.op = TMPL_C_LE;
+		oplen = TMPL_LE_LEN;
 	
 	} else if ( (oppos=exp.find(TMPL_LT)) != exp.npos ) {
 		// <
-		cmpop = TMPL_LT;
-		optype = TMPL_C_LT;
+		cmp.op = TMPL_C_LT;
+		oplen = TMPL_LT_LEN;
 	
 	} else if ( (oppos=exp.find(TMPL_GE)) != exp.npos ) {
 		// >=
-		cmpop = TMPL_GE;
-		optype = TMPL_C_GE;
+		cmp.op = TMPL_C_GE;
+		oplen = TMPL_GE_LEN;
 	
 	} else if ( (oppos=exp.find(TMPL_GT)) != exp.npos ) {
 		// >
-		cmpop = TMPL_GT;
-		optype = TMPL_C_GT;
+		cmp.op = TMPL_C_GT;
+		oplen = TMPL_GT_LEN;
 	
 	} else {
-		// read value, compare and return
-		string val = this->exp_value( exp );
-		if ( val!="" && val!="0" )
-			return true;
-		else
-			return false;
+		// value only
+		cmp.op = TMPL_C_EQ;
+		cmp.lhs = this->compile_value( exp );
+		cmp.rhs = -1;
+		return cmp;
 	}
 
 	// split exp by compare operator
 	String lexp = exp.substr( 0, oppos );
-	String rexp = exp.substr( oppos+cmpop.length() );
-	
-	// read value
+	String rexp = exp.substr( oppos+oplen );
 	lexp.trim(); rexp.trim();
-	lexp = this->exp_value( lexp );
-	rexp = this->exp_value( rexp );
-
-	// compare
-	int cmp;
-	if ( lexp.isnum() && rexp.isnum() ) {
-		int lv = atoi( lexp.c_str() );
-		int rv = atoi( rexp.c_str() );
-		cmp = ( lv>rv ) ? 1 : ( lv==rv ) ? 0 : -1;
-	} else {
-		cmp = strcmp( lexp.c_str(), rexp.c_str() );
-	}
-
-	// return
-	switch ( optype ) {
-		case TMPL_C_EQ:
-			return ( cmp==0 ) ? true : false;
-		case TMPL_C_NE:
-			return ( cmp!=0 ) ? true : false;
-		case TMPL_C_LE:
-			return ( cmp<=0 ) ? true : false;
-		case TMPL_C_LT:
-			return ( cmp<0 ) ? true : false;
-		case TMPL_C_GE:
-			return ( cmp>=0 ) ? true : false;
-		case TMPL_C_GT:
-			return ( cmp>0 ) ? true : false;
-		default:
-			return false;
-	}
+	cmp.lhs = this->compile_value( lexp );
+	cmp.rhs = this->compile_value( rexp );
+	return cmp;
 }
 
-/// Ƿ	
-/// \param exp Ϊʽ
-/// \retval true ʽ
-/// \retval false ʽ
-bool Template::check_if( const string &exp ) {
-	tmpl_logictype exp_type = TMPL_L_NONE;
+/// ʽ
+/// \param exp ʽ
+/// \param line ģ
+/// \return ʽбλ
+int CompiledTemplate::compile_cond( const string &exp, const int line ) {
+	tmpl_cond cond;
+	cond.logic = TMPL_L_NONE;
 	String exps;
 
 	// check expression type
 	if ( strncmp(exp.c_str(),TMPL_AND,TMPL_AND_LEN) == 0 ) {
-		exp_type = TMPL_L_AND;
+		cond.logic = TMPL_L_AND;
 		exps = exp.substr( TMPL_AND_LEN );
 	} else if ( strncmp(exp.c_str(),TMPL_OR,TMPL_OR_LEN) == 0 ) {
-		exp_type = TMPL_L_OR;
+		cond.logic = TMPL_L_OR;
 		exps = exp.substr( TMPL_OR_LEN );
 	}
 
-	// none logic expression
-	if ( exp_type == TMPL_L_NONE )
-		return this->compare( exp );
-
 	// check TMPL_SUBBEGIN/TMPL_SUBEND
-	exps.trim();
-	size_t explen = exps.length();
-	if ( exps.substr(0,TMPL_SUBBEGIN_LEN)!=TMPL_SUBBEGIN ||
-		 exps.substr(explen-TMPL_SUBEND_LEN)!=TMPL_SUBEND ) {
-		this->error_log( _lines, "Warning: Maybe wrong TMPL_AND or TMPL_OR script" );
-		return this->compare( exp );
+	if ( cond.logic != TMPL_L_NONE ) {
+		exps.trim();
+		size_t explen = exps.length();
+		if ( explen<TMPL_SUBBEGIN_LEN+TMPL_SUBEND_LEN ||
+			 exps.substr(0,TMPL_SUBBEGIN_LEN)!=TMPL_SUBBEGIN ||
+			 exps.substr(explen-TMPL_SUBEND_LEN)!=TMPL_SUBEND ) {
+			this->error_log( line, "Warning: Maybe wrong TMPL_AND or TMPL_OR script" );
+			cond.logic = TMPL_L_NONE;
+		}
 	}
-		
-	// split expressions list
-	exps = exps.substr( TMPL_SUBBEGIN_LEN, explen-TMPL_SUBBEGIN_LEN-TMPL_SUBEND_LEN );
-	vector<String> explist = exps.split( TMPL_SPLIT );
 
-	// judge
-	if ( exp_type == TMPL_L_AND ) {
-		// TMPL_AND
-		for ( size_t i=0; i<explist.size(); i++ ) {
-			explist[i].trim();
-			if ( !this->compare(explist[i]) )
-				return false;
-		}
-		return true;
-		
+	if ( cond.logic == TMPL_L_NONE ) {
+		// none logic expression
+		cond.items.push_back( this->compile_cmp(exp) );
 	} else {
-		// TMPL_OR
-		for ( size_t i=0; i<explist.size(); i++ ) {
+		// split expressions list
+		exps = exps.substr( TMPL_SUBBEGIN_LEN, exps.length()-TMPL_SUBBEGIN_LEN-TMPL_SUBEND_LEN );
+		vector<String> explist = exps.split( TMPL_SPLIT );
+		for ( size_t i=0; i<explist.size(); ++i ) {
 			explist[i].trim();
-			if ( this->compare(explist[i]) )
-				return true;
+			cond.items.push_back( this->compile_cmp(explist[i]) );
 		}
-		return false;
 	}
-	
-	return false; // for warning
+
+	_conds.push_back( cond );
+	return _conds.size()-1;
 }
 
-/// ģ
-/// \param tmpl ģַ
-/// \param output 
-/// \param parent_state øúʱ״̬
-/// \param parsed_exp ѷűʽ
-/// \param parsed_length ѷűʽ
-/// \return ֵΪηַ
-size_t Template::parse_if( const string &tmpl, ostream &output, 
-	const bool parent_state, const string &parsed_exp, const int parsed_length ) 
+/// ¼
+/// \param line ģλ
+/// \param error 
+void CompiledTemplate::error_log( const int line, const string &error ) {
+	if ( error != "" )
+		_errlog.insert( multimap<int,string>::value_type(line,error) );
+}
+
+/// ģ
+/// ģűָ,ѭתλ,
+/// δպϵѭģβԶպ,
+/// {{#INCLUDE}}ļڱʱģ,ļе{{#INCLUDE}}ͬtmpl_dir,
+/// ѭͬһļʱ¼󲢺Ը{{#INCLUDE}}
+/// ָ滻ʱ,ֵΪ滻估ֻڱʱ۵Ϊģı
+/// \param tmpl ģ
+/// \param tmpl_dir {{#INCLUDE}}ļ·Ŀ¼,ĬΪǰĿ¼
+/// \param consts 滻,ĬΪ0۵
+void CompiledTemplate::compile( const string &tmpl, const string &tmpl_dir,
+	const RenderContext *consts )
 {
-	// parsed length
-	size_t length = parsed_length;
-		
-	// check status
-	bool status;
-	bool effected;
-	if ( parent_state == false ) {
-		status = false;
-		effected = true;
-	} else if ( this->check_if(parsed_exp) ) {
-		status = true;
-		effected = true;
-	} else {
-		status = false;
-		effected = false;
+	_text = tmpl;
+	_code.clear();
+	_values.clear();
+	_conds.clear();
+	_depends.clear();
+	_errlog.clear();
+	if ( _symbols->size() > 0 ) {
+		// bound RenderContext keeps the old symbols
+		_symbols->release();
+		_symbols = new TemplateSymbol;
 	}
-		
-	// parse
-	size_t lastpos = parsed_length;
-	size_t currpos = parsed_length;
+
+	// open #IF/#FOR: first instruction and last branch
+	vector<size_t> opens;
+	vector<size_t> lasts;
+
+	// inserted #INCLUDE files being compiled: file id and end position in _text
+	vector< pair<dev_t,ino_t> > includes;
+	vector<size_t> include_ends;
+
+	size_t lastpos = 0;
+	size_t currpos = 0;
+	int line = 0;
 
 	// for parse_script()
 	string exp;
 	int type;
 	int parsed;
-	
-	while( (currpos=tmpl.find(TMPL_BEGIN,lastpos)) != tmpl.npos ) {
-		// output html before TMPL_BEGIN if status valid
-		if ( status )
-			output << tmpl.substr( lastpos, currpos-lastpos );
-		length += ( currpos-lastpos );
-		
-		// log current position
-		if ( _debug == TMPL_OUTPUT_DEBUG ) {
-			String orightml = tmpl.substr( lastpos, currpos-lastpos );
-			_lines += orightml.count( TMPL_NEWLINE );
+
+	// search TMPL_BEGIN in tmpl
+	while( (currpos=_text.find(TMPL_BEGIN,lastpos)) != _text.npos ) {
+		// html before TMPL_BEGIN
+		if ( currpos > lastpos )
+			this->append( TMPL_S_TEXT, lastpos, currpos-lastpos, "", line );
+		line += count( _text.begin()+lastpos, _text.begin()+currpos, '\n' );
+
+		// leave finished #INCLUDE files
+		while ( !include_ends.empty() && currpos>=include_ends.back() ) {
+			includes.pop_back();
+			include_ends.pop_back();
 		}
-		
+
 		// get script content between TMPL_BEGIN and TMPL_END
-		parsed = this->parse_script( tmpl, currpos, exp, type );
-		
+		parsed = this->parse_script( _text, currpos, exp, type );
+
 		if ( parsed < 0 ) {
 			// can't find TMPL_END
-			this->error_log( _lines, "Error: Can't find TMPL_END" );
+			this->error_log( line, "Error: Can't find TMPL_END" );
 			lastpos = currpos;
 			break;
 		}
-		
-		// parse by script type
+
+		// compile by script type
+		size_t pc;
 		switch ( type ) {
-			case TMPL_S_VALUE:
-				// replace if status is true
 			case TMPL_S_LOOPVALUE:
-				// replace with loop value if status is true
 			case TMPL_S_CURSOR:
-				// replace with cursor
 			case TMPL_S_ROWS:
-				// replace with rows
+				// only valid in #IF or #FOR
+				if ( opens.empty() ) {
+					this->error_log( line, "Error: Unexpected script, in compile()" );
+					break;
+				}
+			case TMPL_S_VALUE:
 			case TMPL_S_DATE:
-				// replace with date
 			case TMPL_S_TIME:
-				// replace with time
 			case TMPL_S_SPACE:
-				// replace with space char
 			case TMPL_S_BLANK:
-				// replace with blank string
-				if ( status )
-					output << this->exp_value( exp );
+				// replace
+			case TMPL_S_FLUSH:
+				// flush output
+				this->append( type, currpos, parsed, exp, line );
 				break;
 
-			case TMPL_S_ELSIF:
-				// check and set status
-				if ( effected ) {
-					// something effected before
-					status = false;
-				} else if ( this->check_if(exp) ) {
-					// nothing effected and status is true now
-					status = true;
-					effected = true;
-				} else {
-					// nothing effected, status is false now
-					status = false;
-				}
+			case TMPL_S_IF:
+			case TMPL_S_LOOP:
+			case TMPL_S_CACHE:
+				// open block
+				pc = this->append( type, currpos, parsed, exp, line );
+				opens.push_back( pc );
+				lasts.push_back( pc );
 				break;
 
+			case TMPL_S_ELSIF:
 			case TMPL_S_ELSE:
-				// check and set status
-				if ( effected ) {
-					// something effected before
-					status = false;
-				} else {
-					// nothing effected, then status is true
-					status = true;
-					effected = true;
+				// next branch
+				if ( opens.empty() || _code[opens.back()].type!=TMPL_S_IF ) {
+					this->error_log( line, "Error: Unexpected script, in compile()" );
+					break;
 				}
+				pc = this->append( type, currpos, parsed, exp, line );
+				_code[lasts.back()].jump = pc;
+				lasts.back() = pc;
 				break;
 
 			case TMPL_S_ENDIF:
-				// parsed length
-				length += parsed;
-				// exit function
-				return length;
-					
-			case TMPL_S_IF:
-				// sub condition replace
-				parsed = this->parse_if( tmpl.substr(currpos), output, status, exp, parsed );
+				// close condition
+				if ( opens.empty() || _code[opens.back()].type!=TMPL_S_IF ) {
+					this->error_log( line, "Error: Unexpected script, in compile()" );
+					break;
+				}
+				pc = this->append( type, currpos, parsed, exp, line );
+				_code[lasts.back()].jump = pc;
+				for ( size_t i=opens.back(); i!=pc; i=_code[i].jump )
+					_code[i].end = pc;
+				opens.pop_back();
+				lasts.pop_back();
+				break;
+
+			case TMPL_S_ENDLOOP:
+				// close loop
+				if ( opens.empty() || _code[opens.back()].type!=TMPL_S_LOOP ) {
+					this->error_log( line, "Error: Unexpected script, in compile()" );
+					break;
+				}
+				pc = this->append( type, currpos, parsed, exp, line );
+				_code[opens.back()].jump = pc;
+				_code[pc].jump = opens.back();
+				opens.pop_back();
+				lasts.pop_back();
+				break;
+
+			case TMPL_S_ENDCACHE:
+				// close fragment cache
+				if ( opens.empty() || _code[opens.back()].type!=TMPL_S_CACHE ) {
+					this->error_log( line, "Error: Unexpected script, in compile()" );
+					break;
+				}
+				pc = this->append( type, currpos, parsed, exp, line );
+				_code[opens.back()].jump = pc;
+				_code[pc].jump = opens.back();
+				opens.pop_back();
+				lasts.pop_back();
 				break;
-				
-			case TMPL_S_LOOP: { // make compiler happy
-				// backup current loop status
-				string parent_loop = _loop;
-				int parent_cursor = _cursor;
-				
-				// sub cycle replace
-				parsed = this->parse_loop( tmpl.substr(currpos), output, status, exp, parsed );
-				
-				// restore loop status
-				_loop = parent_loop;
-				_cursor = parent_cursor;
-				_loops[_loop].cursor = _cursor;
+
+			case TMPL_S_INCLUDE: {
+				// insert file content, compile it next
+				if ( _depends.size() >= static_cast<size_t>(TMPL_INCLUDE_MAX) ) {
+					this->error_log( line, "Error: Too many TMPL_INCLUDE, maybe recursive" );
+					break;
+				}
+				string file = exp;
+				if ( tmpl_dir!="" && file.compare(0,1,"/")!=0 )
+					file = tmpl_dir + "/" + file;
+
+				struct stat fst;
+				String content;
+				if ( stat(file.c_str(),&fst)!=0 || !content.load_file(file) ) {
+					this->error_log( line, "Error: Can't open TMPL_INCLUDE file " + file );
+					break;
+				}
+
+				// check recursive #INCLUDE
+				pair<dev_t,ino_t> id( fst.st_dev, fst.st_ino );
+				if ( find(includes.begin(),includes.end(),id) != includes.end() ) {
+					this->error_log( line, "Error: Recursive TMPL_INCLUDE file " + file );
+					break;
+				}
+				for ( size_t i=0; i<include_ends.size(); ++i )
+					include_ends[i] += content.length() - parsed;
+				includes.push_back( id );
+				include_ends.push_back( currpos+content.length() );
+
+				tmpl_depend depend;
+				depend.file = file;
+				depend.mtime = fst.st_mtime;
+				depend.size = fst.st_size;
+				_depends.push_back( depend );
+
+				_text.replace( currpos, parsed, content );
+				parsed = 0;
 				}
 				break;
 
-			case TMPL_S_UNKNOWN:
+			case TMPL_S_UNKNOWN: {
 				// unknown script, maybe html code
-				this->error_log( _lines, "Warning: Unknown script, in parse_if()" );
+				this->error_log( line, "Warning: Unknown script, in compile()" );
 
-				// for syntax error
-				size_t backlen;
-				if ( (backlen=exp.find(TMPL_BEGIN)) != exp.npos )
-					parsed = backlen+TMPL_BEGIN_LEN;
+				// for syntax error, output until next TMPL_BEGIN
+				size_t backpos = _text.find( TMPL_BEGIN, currpos+TMPL_BEGIN_LEN );
+				if ( backpos < currpos+parsed )
+					parsed = backpos-currpos;
 
-				if ( status )
-					output << tmpl.substr( currpos, parsed );
+				this->append( TMPL_S_TEXT, currpos, parsed, "", line );
+				}
 				break;
 
 			default:
 				// syntax error
-				error_log( _lines, "Error: Unexpected script, in parse_if()" );
+				this->error_log( line, "Error: Unexpected script, in compile()" );
 		}
 
-		// parsed length
-		length += parsed;
 		// location to next position
+		line += count( _text.begin()+currpos, _text.begin()+currpos+parsed, '\n' );
 		lastpos = currpos + parsed;
 	}
-	
-	// can not find TMPL_ENDIF
-	this->error_log( _lines, "Error: Can't find TMPL_ENDIF" );
 
-	// output tail html
-	if ( status )
-		output << tmpl.substr( lastpos );
-	length += ( tmpl.size()-lastpos );
-	
-	return length;
+	// tail html
+	if ( lastpos < _text.length() )
+		this->append( TMPL_S_TEXT, lastpos, _text.length()-lastpos, "", line );
+	line += count( _text.begin()+lastpos, _text.end(), '\n' );
+
+	// close unclosed blocks
+	while ( !opens.empty() ) {
+		size_t pc;
+		if ( _code[opens.back()].type == TMPL_S_IF ) {
+			this->error_log( line, "Error: Can't find TMPL_ENDIF" );
+			pc = this->append( TMPL_S_ENDIF, _text.length(), 0, "", line );
+			_code[lasts.back()].jump = pc;
+			for ( size_t i=opens.back(); i!=pc; i=_code[i].jump )
+				_code[i].end = pc;
+		} else if ( _code[opens.back()].type == TMPL_S_CACHE ) {
+			this->error_log( line, "Error: Can't find TMPL_ENDCACHE" );
+			pc = this->append( TMPL_S_ENDCACHE, _text.length(), 0, "", line );
+			_code[opens.back()].jump = pc;
+			_code[pc].jump = opens.back();
+		} else {
+			this->error_log( line, "Error: Can't find TMPL_ENDLOOP" );
+			pc = this->append( TMPL_S_ENDLOOP, _text.length(), 0, "", line );
+			_code[opens.back()].jump = pc;
+			_code[pc].jump = pc; // do not cycle
+		}
+		opens.pop_back();
+		lasts.pop_back();
+	}
+
+	// partial evaluation
+	if ( consts != 0 )
+		this->fold( *consts );
 }
 
-/// ѭǷЧ
-/// \param loop ѭѭ
-/// \retval true ѭѶ
-/// \retval false δ
-bool Template::check_loop( const string &loopname ) {
-	string loop = this->exp_value( loopname );
-	
-	if ( _loops.find(loop) != _loops.end() && _loops[loop].rows > 0 ) {
-		return true;
-	} else {
-		this->error_log( _lines, "Warning: loop " + loopname + " \""+loop+
-			"\" not defined or not set data" );
-		return false;
+/// ۵
+/// ֵΪ滻תΪģı,ֻֻķ֧,
+/// ڵģıϲΪһָ,ʱٶȡֵ,
+/// ʱRenderContextͬ滻Ч
+/// \param consts 滻
+void CompiledTemplate::fold( const RenderContext &consts ) {
+	tmpl_state st;
+	this->init_scopes( st, consts );
+	st.errlog = 0;
+	st.loop = -1;
+	st.cursor = 0;
+	st.data = 0;
+	st.owner = 0;
+	st.lines = 0;
+	st.stable = true;
+
+	string text;
+	vector<tmpl_inst> code;
+	vector<size_t> moved( _code.size(), 0 );	// new position of kept instructions
+	vector< pair<size_t,size_t> > skips;		// end of chosen branch, #ENDIF position
+
+	size_t pc = 0;
+	while ( pc < _code.size() ) {
+		// end of chosen branch, skip to #ENDIF
+		if ( !skips.empty() && pc==skips.back().first ) {
+			pc = skips.back().second + 1;
+			skips.pop_back();
+			continue;
+		}
+
+		tmpl_inst inst = _code[pc];
+		switch ( inst.type ) {
+			case TMPL_S_IF: {
+				// find the first true branch if conditions are constant
+				size_t branch = pc;
+				int res = 0;
+				while ( _code[branch].type==TMPL_S_IF || _code[branch].type==TMPL_S_ELSIF ) {
+					if ( (res=this->constant_if(st,_code[branch].cond)) != 0 )
+						break;
+					branch = _code[branch].jump;
+				}
+				if ( res != -1 ) {
+					// keep branch content only
+					if ( _code[branch].type != TMPL_S_ENDIF )
+						skips.push_back( make_pair(_code[branch].jump,inst.end) );
+					pc = branch + 1;
+					continue;
+				}
+				}
+				break;
+
+			case TMPL_S_VALUE:
+			case TMPL_S_SPACE:
+			case TMPL_S_BLANK:
+				// constant value as html
+				if ( !this->constant(st,inst.val) )
+					break;
+			case TMPL_S_TEXT: {
+				// html, merge with last
+				size_t len = inst.len;
+				const char *val = _text.data() + inst.pos;
+				if ( inst.type != TMPL_S_TEXT )
+					val = this->value( st, inst.val, len );
+				if ( !code.empty() && code.back().type==TMPL_S_TEXT
+					&& code.back().pos+code.back().len==text.length() )
+				{
+					code.back().len += len;
+				} else if ( len > 0 ) {
+					inst.type = TMPL_S_TEXT;
+					inst.pos = text.length();
+					inst.len = len;
+					inst.exp = "";
+					inst.val = -1;
+					code.push_back( inst );
+				}
+				text.append( val, len );
+				++pc;
+				continue;
+				}
+		}
+
+		// keep instruction and script
+		moved[pc] = code.size();
+		inst.pos = text.length();
+		text.append( _text, _code[pc].pos, _code[pc].len );
+		code.push_back( inst );
+		++pc;
 	}
+
+	// relocate
+	for ( size_t i=0; i<code.size(); ++i ) {
+		switch ( code[i].type ) {
+			case TMPL_S_IF:
+			case TMPL_S_ELSIF:
+			case TMPL_S_ELSE:
+				code[i].end = moved[code[i].end];
+			case TMPL_S_LOOP:
+			case TMPL_S_ENDLOOP:
+			case TMPL_S_CACHE:
+			case TMPL_S_ENDCACHE:
+				code[i].jump = moved[code[i].jump];
+		}
+	}
+
+	_text.swap( text );
+	_code.swap( code );
 }
 
-/// ѭָλֶεֵ
-/// \param fleid ѭֶ
-/// \return ȡɹֵַ,򷵻ؿַ
-string Template::loop_value( const string &field ) {
-	// get loop info
-	size_t pos = field.find( TMPL_LOOPSCOPE );
-	if ( pos != field.npos ) {
-		string loop_name = this->exp_value( field.substr(pos+TMPL_LOOPSCOPE_LEN) );
-		string field_name = field.substr( 0, pos );
-		int cursor = _loops[loop_name].cursor;
+/// HTMLԭԪ
+/// Ԫݲѹ
+static const char* TMPL_MINIFY_RAW[] = { "pre", "textarea", "script", "style", 0 };
+
+/// ѹģı
+/// ϲĿհַ,ɾHTMLע,ֻģı,ģűֵ,
+/// <pre><textarea><script><style>Ԫصݡǩڵֵ
+/// ע<!--[if ...]>ֲ,һ,ʱٴ
+void CompiledTemplate::minify() {
+	string text;
+	string raw;				// raw element name, empty if not in raw element
+	string tag;				// current tag name
+	bool intag = false;		// in tag
+	bool closing = false;	// in closing tag
+	bool comment = false;	// in kept comment
+	char quote = 0;			// in quoted attribute value
+
+	for ( size_t i=0; i<_code.size(); ++i ) {
+		tmpl_inst &inst = _code[i];
+		const char *p = _text.data() + inst.pos;
+		const char *e = p + inst.len;
+		inst.pos = text.length();
+
+		// keep script
+		if ( inst.type != TMPL_S_TEXT ) {
+			text.append( p, inst.len );
+			continue;
+		}
 
-		// return value
-		int col = this->field_pos( loop_name, field_name );
-		if ( col!=-1 && cursor<_loops[loop_name].rows )
-			return _loops[loop_name].datas[cursor][col];
-		else
-			return string( "" );
-	} else {
-		// return value
-		int col = this->field_pos( _loop, field );
-		if ( col!=-1 && _cursor<_loops[_loop].rows )
-			return _loops[_loop].datas[_cursor][col];
-		else
-			return string( "" );
+		while ( p < e ) {
+			const char *q;
+			if ( comment ) {
+				// kept comment, until -->
+				q = search( p, e, "-->", "-->"+3 );
+				if ( q < e ) {
+					q += 3;
+					comment = false;
+				}
+				text.append( p, q-p );
+				p = q;
+
+			} else if ( !raw.empty() ) {
+				// raw element content, until </name
+				for ( q=p; q<e; ++q ) {
+					if ( q[0]=='<' && static_cast<size_t>(e-q)>=raw.length()+2 && q[1]=='/'
+						&& strncasecmp(q+2,raw.c_str(),raw.length())==0 )
+						break;
+				}
+				text.append( p, q-p );
+				if ( q < e )
+					raw.clear();
+				p = q;
+
+			} else if ( quote != 0 ) {
+				// attribute value
+				q = static_cast<const char*>( memchr(p,quote,e-p) );
+				if ( q != 0 ) {
+					++q;
+					quote = 0;
+				} else {
+					q = e;
+				}
+				text.append( p, q-p );
+				p = q;
+
+			} else if ( isspace(static_cast<unsigned char>(*p)) ) {
+				// collapse whitespace
+				bool newline = false;
+				for ( q=p; q<e && isspace(static_cast<unsigned char>(*q)); ++q ) {
+					if ( *q == '\n' )
+						newline = true;
+				}
+				text += newline ? '\n' : ' ';
+				p = q;
+
+			} else if ( intag ) {
+				// tag attributes
+				if ( *p=='"' || *p=='\'' ) {
+					quote = *p;
+				} else if ( *p == '>' ) {
+					intag = false;
+					for ( int n=0; !closing && TMPL_MINIFY_RAW[n]!=0; ++n ) {
+						if ( tag == TMPL_MINIFY_RAW[n] )
+							raw = tag;
+					}
+				}
+				text += *p++;
+
+			} else if ( *p=='<' && e-p>=4 && strncmp(p,"<!--",4)==0 ) {
+				// comment, keep conditional comment and comment not closed
+				q = search( p+4, e, "-->", "-->"+3 );
+				if ( q<e && p[4]!='[' ) {
+					p = q+3;
+				} else {
+					comment = true;
+					text.append( p, 4 );
+					p += 4;
+				}
+
+			} else if ( *p=='<' && p+1<e && (isalpha(static_cast<unsigned char>(p[1])) 
+				|| p[1]=='/' || p[1]=='!') )
+			{
+				// tag name
+				closing = ( p[1] == '/' );
+				tag.clear();
+				for ( q=p+(closing?2:1); q<e && isalnum(static_cast<unsigned char>(*q)); ++q )
+					tag += tolower( static_cast<unsigned char>(*q) );
+				intag = true;
+				text += *p++;
+
+			} else {
+				text += *p++;
+			}
+		}
+		inst.len = text.length() - inst.pos;
 	}
+
+	_text.swap( text );
 }
 
-/// ѭģ
-/// \param tmpl ģַ
-/// \param output 
-/// \param parent_state øúʱ״̬
-/// \param parsed_exp ѷѭűʽ
-/// \param parsed_length ѷѭűʽ
-/// \return ֵΪηַ
-size_t Template::parse_loop( const string &tmpl, ostream &output, 
-	const bool parent_state, const string &parsed_exp, const int parsed_length ) 
+/// ʽǷΪ
+/// \param st ,Ϊ滻
+/// \param val ʽλ
+/// \retval true ʽΪַõĳ
+/// \retval false ǳ
+bool CompiledTemplate::constant( const tmpl_state &st, const int val ) const {
+	if ( val < 0 )
+		return false;
+	const tmpl_value &v = _values[val];
+	if ( v.type == TMPL_S_TEXT )
+		return true;
+	int pos;
+	if ( v.type == TMPL_S_VALUE )
+		return this->lookup( st, v.slot, pos ) != 0;
+	return false;
+}
+
+/// 㳣
+/// \param st ,Ϊ滻
+/// \param cond ʽλ
+/// \return 1,0,ǳ-1
+int CompiledTemplate::constant_if( tmpl_state &st, const int cond ) const {
+	if ( cond < 0 )
+		return -1;
+	const tmpl_cond &c = _conds[cond];
+	for ( size_t i=0; i<c.items.size(); ++i ) {
+		if ( !this->constant(st,c.items[i].lhs) 
+			|| (c.items[i].rhs!=-1 && !this->constant(st,c.items[i].rhs)) )
+			return -1;
+	}
+	return this->check_if( st, cond ) ? 1 : 0;
+}
+
+/// ļǷ޸
+/// {{#INCLUDE}}ļ޸ʱ估С
+/// \retval true ļ޸Ļɾ
+/// \retval false δ޸
+bool CompiledTemplate::modified() const {
+	struct stat st;
+	for ( size_t i=0; i<_depends.size(); ++i ) {
+		if ( stat(_depends[i].file.c_str(),&st) != 0 
+			|| st.st_mtime!=_depends[i].mtime || st.st_size!=_depends[i].size )
+			return true;
+	}
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// cache functions
+
+/// ؽ̹ģ建
+/// Template::load_cached()ʹøû
+/// \return ģ建
+TemplateCache& TemplateCache::instance() {
+	static TemplateCache cache;
+	return cache;
+}
+
+/// 캯
+/// \param interval ģļ޸ʱļ,λΪ,
+/// Ϊ0ʱÿζ,С0ʱ,ĬΪ1
+TemplateCache::TemplateCache( const int interval ):
+_interval(interval), _inotify(-1), _inotify_serial(0), _fold(false), _minify(false), _generation(0)
 {
-	// parsed length
-	size_t length = parsed_length;
-		
-	// check status
-	bool status;
-	if ( parent_state == false )
-		status = false;
-	else if ( this->check_loop(parsed_exp) )
-		status = true;
-	else
-		status = false;
-		
-	// init
-	bool cycled = false;
-	int cursor = 0;
-	size_t start_pos = parsed_length;
-	size_t start_len = parsed_length;
-	size_t lastpos = parsed_length;
-	size_t currpos = parsed_length;
-	
-	// current loop name
-	string loop = this->exp_value( parsed_exp );
-	_loop = loop;
-	_loops[_loop].cursor = 0;
+	pthread_rwlock_init( &_lock, NULL );
+}
 
-	// for parse_script()		
-	string exp;
-	int type;
-	int parsed;
+/// 
+TemplateCache::~TemplateCache() {
+	this->set_inotify( false );
+	pthread_rwlock_destroy( &_lock );
+}
 
-	while( (currpos=tmpl.find(TMPL_BEGIN,lastpos)) != tmpl.npos ) {
-		// output html before TMPL_BEGIN if status valid
-		if ( status )
-			output << tmpl.substr( lastpos, currpos-lastpos );
-		length += ( currpos-lastpos );
-		
-		// log current position
-		if ( !cycled && _debug==TMPL_OUTPUT_DEBUG ) {
-			String orightml = tmpl.substr( lastpos, currpos-lastpos );
-			_lines += orightml.count( TMPL_NEWLINE );
-		}
-		
-		// get script content between TMPL_BEGIN and TMPL_END
-		parsed = this->parse_script( tmpl, currpos, exp, type );
-		
-		if ( parsed < 0 ) {
-			// can't find TMPL_END
-			if ( !cycled )
-				this->error_log( _lines, "Error: Can't find TMPL_END" );
-			lastpos = currpos;
-			break;
+/// رģ
+/// ģδ޸ʱȡģļ,ֱӷػ,
+/// ʱ,߳̿Լȡ,
+/// ʹinotifyʱӼʧܵģ԰޸ʱ
+/// \param tmpl_file ģļ·
+/// \return ģ,ȡʧܷؿָ
+CompiledTemplatePtr TemplateCache::get( const string &tmpl_file ) {
+	CompiledTemplatePtr code;
+	time_t now = time( 0 );
+
+	// read inotify events
+	this->check_inotify();
+
+	// cached
+	pthread_rwlock_rdlock( &_lock );
+	bool inotify = ( _inotify != -1 );
+	unsigned int serial = _inotify_serial;
+	map<string,cache_entry>::const_iterator i = _entries.find( tmpl_file );
+	if ( i!=_entries.end() && !(i->second).dirty && (i->second).generation==_generation ) {
+		if ( (inotify && (i->second).watched) || _interval<0 || now-(i->second).checked<_interval )
+			code = (i->second).code;
+	}
+	pthread_rwlock_unlock( &_lock );
+	if ( code.get() != 0 )
+		return code;
+
+	// watch before stat, do not miss changes
+	int wd = -1;
+	if ( inotify )
+		wd = this->add_watch( tmpl_file );
+
+	// check modify time
+	struct stat st;
+	if ( stat(tmpl_file.c_str(),&st) != 0 ) {
+		this->remove( tmpl_file );
+		return code;
+	}
+
+	bool watched = false;
+	pthread_rwlock_wrlock( &_lock );
+	map<string,cache_entry>::iterator j = _entries.find( tmpl_file );
+	if ( j!=_entries.end() && !(j->second).dirty && (j->second).generation==_generation
+		&& (j->second).mtime==st.st_mtime && (j->second).size==st.st_size ) {
+		(j->second).checked = now;
+		code = (j->second).code;
+		watched = (j->second).watched && _inotify!=-1;
+	}
+	pthread_rwlock_unlock( &_lock );
+
+	// included files
+	if ( code.get()!=0 && (watched || !code->modified()) )
+		return code;
+
+	// constants of current generation
+	RenderContext consts;
+	pthread_rwlock_rdlock( &_lock );
+	unsigned int generation = _generation;
+	bool fold = _fold;
+	bool minify = _minify;
+	if ( fold )
+		consts = _consts;
+	pthread_rwlock_unlock( &_lock );
+
+	// compile
+	String tmpl;
+	if ( !tmpl.load_file(tmpl_file) )
+		return CompiledTemplatePtr();
+	CompiledTemplate *compiled = new CompiledTemplate( tmpl, tmpl_dirname(tmpl_file), fold?&consts:0 );
+	if ( minify )
+		compiled->minify();
+	code = CompiledTemplatePtr( compiled );
+
+	// replace
+	cache_entry entry;
+	entry.code = code;
+	entry.mtime = st.st_mtime;
+	entry.size = st.st_size;
+	entry.checked = now;
+	entry.dirty = false;
+	entry.watched = ( wd != -1 );
+	entry.generation = generation;
+	entry.watches.push_back( pair<int,string>(wd,tmpl_basename(tmpl_file)) );
+	if ( entry.watched ) {
+		// watch included files, check once for changes before watched
+		const vector<tmpl_depend> &depends = code->depends();
+		for ( size_t i=0; i<depends.size(); ++i ) {
+			int dwd = this->add_watch( depends[i].file );
+			if ( dwd == -1 )
+				entry.watched = false;
+			entry.watches.push_back( pair<int,string>(dwd,tmpl_basename(depends[i].file)) );
 		}
-		
-		// current loop cursor
-		_cursor = cursor;
+		entry.dirty = code->modified();
+	}
 
-		// parse by script type
-		switch ( type ) {
-			case TMPL_S_VALUE:
-				// replace
-			case TMPL_S_LOOPVALUE:
-				// replace with loop value in loop
-			case TMPL_S_CURSOR:
-				// replace with cursor
-			case TMPL_S_ROWS:
-				// replace with rows				
-			case TMPL_S_DATE:
-				// replace with date
-			case TMPL_S_TIME:
-				// replace with time
-			case TMPL_S_SPACE:
-				// replace with space char
-			case TMPL_S_BLANK:
-				// replace with blank string
-				if ( status )           
-					output << this->exp_value( exp );
-				break;
+	pthread_rwlock_wrlock( &_lock );
+	// inotify restarted while compiling, watches are invalid
+	if ( entry.watched && serial!=_inotify_serial )
+		entry.dirty = true;
+	_entries[tmpl_file] = entry;
+	pthread_rwlock_unlock( &_lock );
 
-			case TMPL_S_ENDLOOP:
-				// at the end of this cycle
-				++cursor; // data cursor
-				_loops[_loop].cursor = cursor;
-				if ( status && cursor<_loops[loop].rows ) {
-					// next cycle
-					length = start_len;		// reset parsed length
-					lastpos = start_pos;	// reset start position
-					cycled = true;			// do not add current position value
-					continue;
-				} else {
-					// parsed length
-					length += parsed;
-					// exit function
-					return length;
-				}
-					
-			case TMPL_S_IF:
-				// sub condition replace
-				parsed = this->parse_if( tmpl.substr(currpos), output, status, exp, parsed );
-				break;
-				
-			case TMPL_S_LOOP:
-				// sub cycle replace
-				parsed = this->parse_loop( tmpl.substr(currpos), output, status, exp, parsed );
-				// restore loop status
-				_loop = loop;
-				_cursor = cursor;
-				_loops[_loop].cursor = _cursor;
-				break;
+	return code;
+}
 
-			case TMPL_S_UNKNOWN:
-				// unknown script, maybe html code
-				if ( !cycled )
-					this->error_log( _lines, "Warning: Unknown script, in parse_loop()" );
+/// üģļ޸ʱļ
+/// ʹinotifyʱģļ޸ʱ
+/// \param interval ,λΪ,Ϊ0ʱÿζ,С0ʱ
+void TemplateCache::set_interval( const int interval ) {
+	pthread_rwlock_wrlock( &_lock );
+	_interval = interval;
+	pthread_rwlock_unlock( &_lock );
+}
 
-				// for syntax error
-				size_t backlen;
-				if ( (backlen=exp.find(TMPL_BEGIN)) != exp.npos )
-					parsed = backlen+TMPL_BEGIN_LEN;
+/// ʹinotifyģļ޸
+/// ֧Linuxϵͳ,ģļĿ¼,ģļ޸ġ滻ɾ±
+/// \param enable Ƿʹinotify
+/// \retval true óɹ
+/// \retval false ʧ,ϵͳ֧inotify
+bool TemplateCache::set_inotify( const bool enable ) {
+	#ifdef __linux__
+	pthread_rwlock_wrlock( &_lock );
+	if ( enable && _inotify==-1 ) {
+		_inotify = inotify_init1( IN_NONBLOCK|IN_CLOEXEC );
+		++_inotify_serial;
+	} else if ( !enable && _inotify!=-1 ) {
+		close( _inotify );
+		_inotify = -1;
+		_watches.clear();
+		++_inotify_serial;
+	}
 
-				if ( status )
-					output << tmpl.substr( currpos, parsed );
-				break;
+	// check all again
+	for ( map<string,cache_entry>::iterator i=_entries.begin(); i!=_entries.end(); ++i ) {
+		(i->second).dirty = true;
+		(i->second).watched = false;
+		(i->second).watches.clear();
+	}
 
-			default:
-				// syntax error
-				if ( !cycled )
-					this->error_log( _lines, "Error: Unexpected script, in parse_loop()" );
+	bool res = ( enable == (_inotify!=-1) );
+	pthread_rwlock_unlock( &_lock );
+	return res;
+	#else
+	return !enable;
+	#endif
+}
+
+/// inotifyĿ¼
+/// \param tmpl_file ģļ·
+/// \return inotify,ʧܷ-1
+int TemplateCache::add_watch( const string &tmpl_file ) {
+	#ifdef __linux__
+	string dir = tmpl_dirname( tmpl_file );
+
+	pthread_rwlock_wrlock( &_lock );
+	int wd = -1;
+	if ( _inotify != -1 ) {
+		wd = inotify_add_watch( _inotify, dir.c_str(),
+			IN_CLOSE_WRITE|IN_MOVED_TO|IN_MOVED_FROM|IN_DELETE|IN_CREATE|IN_ATTRIB );
+		if ( wd != -1 )
+			_watches[wd] = dir;
+	}
+	pthread_rwlock_unlock( &_lock );
+	return wd;
+	#else
+	return -1;
+	#endif
+}
+
+/// ȡinotify¼
+/// ¼ʱǶӦģ建Ϊ޸,
+/// ȡʱ,set_inotify()ͬʱرinotify
+void TemplateCache::check_inotify() {
+	#ifdef __linux__
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+
+	for ( ;; ) {
+		pthread_rwlock_rdlock( &_lock );
+		len = ( _inotify!=-1 ) ? read( _inotify, buf, sizeof(buf) ) : -1;
+		pthread_rwlock_unlock( &_lock );
+		if ( len <= 0 )
+			break;
+
+		pthread_rwlock_wrlock( &_lock );
+		for ( char *p=buf; p<buf+len; p+=sizeof(struct inotify_event)+((struct inotify_event*)p)->len ) {
+			const struct inotify_event *ev = (const struct inotify_event*)p;
+			map<string,cache_entry>::iterator i;
+			for ( i=_entries.begin(); i!=_entries.end(); ++i ) {
+				const vector< pair<int,string> > &watches = (i->second).watches;
+				for ( size_t w=0; w<watches.size(); ++w ) {
+					if ( (ev->mask&IN_Q_OVERFLOW) || (watches[w].first==ev->wd
+						&& ((ev->mask&IN_IGNORED) || (ev->len>0 && watches[w].second==ev->name))) )
+						(i->second).dirty = true;
+				}
+			}
+			if ( ev->mask & IN_IGNORED )
+				_watches.erase( ev->wd );
 		}
+		pthread_rwlock_unlock( &_lock );
+	}
+	#endif
+}
 
-		// parsed length
-		length += parsed;
-		// location to next position
-		lastpos = currpos + parsed;
+/// ó滻
+/// Ϊÿͬ滻ֵ,վơ̬ļַ汾ŵ,
+/// ʱ滻估ֻ۵Ϊģı,ʱٶȡ,
+/// ú汾,ѻģ´ζȡʱµĳ±
+/// \param consts 滻,ֻʹе滻ֵ,ʹѭ
+void TemplateCache::set_consts( const RenderContext &consts ) {
+	pthread_rwlock_wrlock( &_lock );
+	_consts = consts;
+	_fold = true;
+	++_generation;
+	pthread_rwlock_unlock( &_lock );
+}
+
+/// 滻
+/// ѻģ´ζȡʱ±,۵
+void TemplateCache::clear_consts() {
+	pthread_rwlock_wrlock( &_lock );
+	_consts.clear_set();
+	_fold = false;
+	++_generation;
+	pthread_rwlock_unlock( &_lock );
+}
+
+/// س汾
+/// \return 汾,ÿûʱ
+unsigned int TemplateCache::generation() {
+	pthread_rwlock_rdlock( &_lock );
+	unsigned int generation = _generation;
+	pthread_rwlock_unlock( &_lock );
+	return generation;
+}
+
+/// Ƿѹģı
+/// CompiledTemplate::minify(),޸ĺ汾,ѻģ´ζȡʱ±
+/// \param enable Ƿѹ
+void TemplateCache::set_minify( const bool enable ) {
+	pthread_rwlock_wrlock( &_lock );
+	if ( _minify != enable ) {
+		_minify = enable;
+		++_generation;
 	}
-	
-	// can not find TMPL_ENDLOOP
-	this->error_log( _lines, "Error: Can't find TMPL_ENDLOOP" );
+	pthread_rwlock_unlock( &_lock );
+}
 
-	// output tail html
-	if ( status )
-		output << tmpl.substr( lastpos );
-	length += ( tmpl.size()-lastpos );
+/// ɾָģ建
+/// \param tmpl_file ģļ·
+void TemplateCache::remove( const string &tmpl_file ) {
+	pthread_rwlock_wrlock( &_lock );
+	_entries.erase( tmpl_file );
+	pthread_rwlock_unlock( &_lock );
+}
 
-	return length;
+/// ģ建
+void TemplateCache::clear() {
+	pthread_rwlock_wrlock( &_lock );
+	_entries.clear();
+	pthread_rwlock_unlock( &_lock );
 }
 
-////////////////////////////////////////////////////////////////////////////
-// output functions
+/// ػģ
+/// \return ģ
+size_t TemplateCache::size() {
+	pthread_rwlock_rdlock( &_lock );
+	size_t n = _entries.size();
+	pthread_rwlock_unlock( &_lock );
+	return n;
+}
 
-/// ģ¼
-/// \param pos ģλ
-/// \param error 
-void Template::error_log( const size_t lines, const string &error ) {
-	if ( error != "" )
-		_errlog.insert( multimap<int,string>::value_type(lines,error) );
+/// ؽ̹Ƭλ
+/// ģе{{#CACHE}}ʹøû
+/// \return Ƭλ
+FragmentCache& FragmentCache::instance() {
+	static FragmentCache cache;
+	return cache;
 }
 
-/// ģ¼
-/// \param output 
-void Template::parse_log( ostream &output ) {
-	output << endl;
-	output << "<!-- Generated by waTemplate " << _date << " " << _time << endl
-		<< "  Templet source: " << _tmplfile << endl
-		<< "  Loops: " << _loops.size() << endl;
+/// 캯
+/// \param capacity ,λΪֽ,ĬΪ16M
+FragmentCache::FragmentCache( const size_t capacity ):
+_capacity(capacity), _bytes(0)
+{
+	pthread_mutex_init( &_lock, NULL );
+}
 
-	for ( map<string,tmpl_loop>::const_iterator i=_loops.begin(); i!=_loops.end(); ++i ) {
-		if ( i->first != "" ) {
-			output << "    Loop " << i->first
-				<< "\t\t" << (i->second).cursor << " rows" << endl;
+/// 
+FragmentCache::~FragmentCache() {
+	pthread_mutex_destroy( &_lock );
+}
+
+/// ȡƬ
+/// Ƭѹʱɾ
+/// \param key 
+/// \param data Ƭ
+/// \retval true ȡɹ
+/// \retval false Ƭβڻѹ
+bool FragmentCache::get( const string &key, string &data ) {
+	bool found = false;
+	pthread_mutex_lock( &_lock );
+	map<string,cache_list::iterator>::iterator i = _entries.find( key );
+	if ( i != _entries.end() ) {
+		cache_list::iterator entry = i->second;
+		if ( entry->expires!=0 && entry->expires<=time(0) ) {
+			// expired
+			_bytes -= entry->data.length();
+			_lru.erase( entry );
+			_entries.erase( i );
+		} else {
+			// most recently used
+			_lru.splice( _lru.begin(), _lru, entry );
+			data = entry->data;
+			found = true;
 		}
 	}
+	pthread_mutex_unlock( &_lock );
+	return found;
+}
 
-	output << "  Errors: " << _errlog.size() << endl;
-	for ( multimap<int,string>::const_iterator i=_errlog.begin(); i!=_errlog.end(); ++i ) {
-		output << "    Line " << i->first+1
-			<< "\t\t" << i->second << endl;
+/// Ƭ
+/// \param key 
+/// \param data Ƭ
+/// \param ttl Чʱ,λΪ,Сڵ0Ϊ,ĬΪ0
+void FragmentCache::set( const string &key, const string &data, const int ttl ) {
+	if ( data.length() > _capacity )
+		return;
+
+	pthread_mutex_lock( &_lock );
+	map<string,cache_list::iterator>::iterator i = _entries.find( key );
+	if ( i != _entries.end() ) {
+		_bytes -= i->second->data.length();
+		_lru.erase( i->second );
+		_entries.erase( i );
 	}
-			   
-	output << "-->";
-	_errlog.clear();
+
+	cache_entry entry;
+	entry.key = key;
+	entry.expires = ( ttl>0 ) ? time(0)+ttl : 0;
+	_lru.push_front( entry );
+	_lru.front().data = data;
+	_entries[key] = _lru.begin();
+	_bytes += data.length();
+
+	this->shrink();
+	pthread_mutex_unlock( &_lock );
 }
 
-/// HTMLַ
-/// \return ģ
-string Template::html() {
-	ostringstream result;
-	this->parse( _tmpl, result );
-	result << ends;
-	return result.str();
+/// ɾδʹõƬֱ
+/// ǰ
+void FragmentCache::shrink() {
+	while ( _bytes>_capacity && !_lru.empty() ) {
+		_bytes -= _lru.back().data.length();
+		_entries.erase( _lru.back().key );
+		_lru.pop_back();
+	}
 }
 
-/// HTMLstdout
-/// \param mode ǷϢ
-/// - Template::TMPL_OUTPUT_DEBUG Ϣ
-/// - Template::TMPL_OUTPUT_RELEASE Ϣ
-/// - ĬΪϢ
-void Template::print( const output_mode mode ) {
-	_debug = mode;
-	this->parse( _tmpl, std::cout );
-	if ( _debug == TMPL_OUTPUT_DEBUG ) 
-		this->parse_log( std::cout );
+/// û
+/// \param capacity ,λΪֽ
+void FragmentCache::set_capacity( const size_t capacity ) {
+	pthread_mutex_lock( &_lock );
+	_capacity = capacity;
+	this->shrink();
+	pthread_mutex_unlock( &_lock );
+}
+
+/// ɾָƬ
+/// \param key 
+void FragmentCache::remove( const string &key ) {
+	pthread_mutex_lock( &_lock );
+	map<string,cache_list::iterator>::iterator i = _entries.find( key );
+	if ( i != _entries.end() ) {
+		_bytes -= i->second->data.length();
+		_lru.erase( i->second );
+		_entries.erase( i );
+	}
+	pthread_mutex_unlock( &_lock );
+}
+
+/// Ƭλ
+void FragmentCache::clear() {
+	pthread_mutex_lock( &_lock );
+	_lru.clear();
+	_entries.clear();
+	_bytes = 0;
+	pthread_mutex_unlock( &_lock );
+}
+
+/// ػƬ
+/// \return Ƭ
+size_t FragmentCache::size() {
+	pthread_mutex_lock( &_lock );
+	size_t n = _entries.size();
+	pthread_mutex_unlock( &_lock );
+	return n;
+}
+
+/// ػƬܳ
+/// \return Ƭܳ,λΪֽ
+size_t FragmentCache::bytes() {
+	pthread_mutex_lock( &_lock );
+	size_t n = _bytes;
+	pthread_mutex_unlock( &_lock );
+	return n;
+}
+
+#ifndef _WEBAPPLIB_NOMYSQL
+////////////////////////////////////////////////////////////////////////////
+// rows functions
+
+/// 캯
+/// ȡݼиеMYSQL_ROWָ뼰ݳ
+/// \param data MysqlDataݼ
+MysqlRows::MysqlRows( MysqlData &data ) {
+	if ( data._mysqlres == NULL )
+		return;
+
+	for ( size_t i=0; i<data.cols(); ++i )
+		_fields.push_back( data.field_name(i) );
+
+	_rows.reserve( data.rows() );
+	_lengths.reserve( data.rows()*data.cols() );
+	mysql_data_seek( data._mysqlres, 0 );
+	for ( size_t i=0; i<data.rows(); ++i ) {
+		MYSQL_ROW row = mysql_fetch_row( data._mysqlres );
+		unsigned long *lengths = mysql_fetch_lengths( data._mysqlres );
+		if ( row == NULL || lengths == NULL )
+			break;
+		_rows.push_back( row );
+		_lengths.insert( _lengths.end(), lengths, lengths+data.cols() );
+	}
+
+	// restore MysqlData cursor
+	mysql_data_seek( data._mysqlres, 0 );
+	data._mysqlrow = mysql_fetch_row( data._mysqlres );
+	data._curpos = 0;
+	data._fetched = 0;
+}
+
+/// 
+/// \param row λ
+/// \param col ֶλ
+/// \param len ݳ
+/// \return ݿʼλ,ֵֶΪNULLʱؿַ
+const char* MysqlRows::cell( const size_t row, const size_t col, size_t &len ) const {
+	const char *val = _rows[row][col];
+	if ( val == NULL ) {
+		len = 0;
+		return "";
+	}
+	len = _lengths[row*_fields.size()+col];
+	return val;
+}
+#endif //_WEBAPPLIB_NOMYSQL
+
+////////////////////////////////////////////////////////////////////////////
+// pool functions
+
+/// ؽ̹̳߳
+/// ѭʹø̳߳,Ĭ߳Ϊ0,
+/// \return ̳߳ض
+TemplatePool& TemplatePool::instance() {
+	static TemplatePool pool;
+	return pool;
+}
+
+/// 캯
+/// \param threads ߳,ĬΪ0
+TemplatePool::TemplatePool( const int threads ):
+_size(0), _stop(false)
+{
+	pthread_mutex_init( &_lock, NULL );
+	pthread_cond_init( &_wake, NULL );
+	pthread_cond_init( &_done, NULL );
+	this->set_threads( threads );
+}
+
+/// 
+TemplatePool::~TemplatePool() {
+	this->set_threads( 0 );
+	pthread_cond_destroy( &_done );
+	pthread_cond_destroy( &_wake );
+	pthread_mutex_destroy( &_lock );
+}
+
+/// ߳
+/// ֹ̺ͣ߳󴴽µ߳,δִеɵrun()ִ߳,
+/// ͬʱڶ߳е
+/// \param threads ߳,Ϊ0ʱֹͣ߳
+void TemplatePool::set_threads( const int threads ) {
+	// stop
+	pthread_mutex_lock( &_lock );
+	_stop = true;
+	_size = 0;
+	pthread_cond_broadcast( &_wake );
+	pthread_mutex_unlock( &_lock );
+	for ( size_t i=0; i<_threads.size(); ++i )
+		pthread_join( _threads[i], NULL );
+	_threads.clear();
+
+	// start
+	_stop = false;
+	for ( int i=0; i<threads; ++i ) {
+		pthread_t tid;
+		if ( pthread_create(&tid,NULL,TemplatePool::worker,this) == 0 )
+			_threads.push_back( tid );
+	}
+
+	pthread_mutex_lock( &_lock );
+	_size = _threads.size();
+	pthread_mutex_unlock( &_lock );
+}
+
+/// ߳
+/// \return ߳
+int TemplatePool::threads() {
+	pthread_mutex_lock( &_lock );
+	int size = _size;
+	pthread_mutex_unlock( &_lock );
+	return size;
+}
+
+/// ִ
+/// һڵִ߳,̳߳еִ߳,
+/// ִ߳ɺִδʼ,ֱȫɺ󷵻
+/// \param func 
+/// \param args б
+/// \param count 
+void TemplatePool::run( const task_func func, void **args, const size_t count ) {
+	if ( count == 0 )
+		return;
+
+	size_t pending = count-1;
+	pthread_mutex_lock( &_lock );
+	for ( size_t i=1; i<count; ++i ) {
+		pool_task task = { func, args[i], &pending };
+		_tasks.push_back( task );
+	}
+	pthread_cond_broadcast( &_wake );
+	pthread_mutex_unlock( &_lock );
+
+	func( args[0] );
+
+	// help others, wait until finished
+	pthread_mutex_lock( &_lock );
+	while ( pending > 0 ) {
+		if ( !_tasks.empty() )
+			this->execute();
+		else
+			pthread_cond_wait( &_done, &_lock );
+	}
+	pthread_mutex_unlock( &_lock );
+}
+
+/// ִһ񲢸
+/// ǰ,ִڼ
+void TemplatePool::execute() {
+	pool_task task = _tasks.front();
+	_tasks.pop_front();
+	pthread_mutex_unlock( &_lock );
+
+	task.func( task.arg );
+
+	pthread_mutex_lock( &_lock );
+	if ( --(*task.pending) == 0 )
+		pthread_cond_broadcast( &_done );
+}
+
+/// ̺߳
+/// \param pool ̳߳
+/// \return ̷ֵ߳,NULL
+void* TemplatePool::worker( void *pool ) {
+	TemplatePool *self = static_cast<TemplatePool*>( pool );
+	pthread_mutex_lock( &self->_lock );
+	while ( !self->_stop ) {
+		if ( !self->_tasks.empty() )
+			self->execute();
+		else
+			pthread_cond_wait( &self->_wake, &self->_lock );
+	}
+	pthread_mutex_unlock( &self->_lock );
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// data functions
+
+/// ֵ
+/// \param copy Դ
+RenderContext& RenderContext::operator = ( const RenderContext &copy ) {
+	if ( this != &copy ) {
+		this->clear_set();
+		if ( copy._symbols != 0 )
+			copy._symbols->retain();
+		if ( _symbols != 0 )
+			_symbols->release();
+		_symbols = copy._symbols;
+		_others = copy._others;
+		_sets = copy._sets;
+		_vars = copy._vars;
+		_isset = copy._isset;
+		_errlog = copy._errlog;
+		_parent = copy._parent;
+		_parallel = copy._parallel;
+		_loops.resize( copy._loops.size(), 0 );
+		for ( size_t i=0; i<_loops.size(); ++i ) {
+			if ( copy._loops[i] != 0 ) {
+				_loops[i] = new tmpl_loop( *copy._loops[i] );
+				if ( _loops[i]->owned != 0 ) {
+					_loops[i]->owned = _loops[i]->owned->clone();
+					if ( _loops[i]->owned != 0 )
+						_loops[i]->source = _loops[i]->owned;
+				}
+			}
+		}
+	}
+	return *this;
+}
+
+/// 滻
+/// \param name ģ
+/// \param value 滻ֵ
+void RenderContext::set( const string &name, const string &value ) {
+	if ( name == "" )
+		return;
+
+	size_t slot = this->var( name );
+	_sets[slot] = value;
+	_vars[slot].type = TMPL_V_TEXT;
+}
+
+/// 滻
+/// ʱתΪַ,Ƚʱֱʹֵ
+/// \param name ģ
+/// \param value 滻ֵ
+void RenderContext::set( const string &name, const long value ) {
+	if ( name == "" )
+		return;
+
+	size_t slot = this->var( name );
+	_sets[slot].clear();
+	_vars[slot].type = TMPL_V_INT;
+	_vars[slot].num = value;
+}
+
+/// ø滻
+/// ʱתΪַ,Ƚʱֱʹøֵ
+/// \param name ģ
+/// \param value 滻ֵ
+/// \param ndigit ʱСλ,ĬΪ2
+void RenderContext::set( const string &name, const double value, const int ndigit ) {
+	if ( name == "" )
+		return;
+
+	size_t slot = this->var( name );
+	_sets[slot].clear();
+	_vars[slot].type = TMPL_V_REAL;
+	_vars[slot].real = value;
+	_vars[slot].ndigit = ndigit;
+}
+
+/// òֵ滻
+/// Ϊ"1""0"
+/// \param name ģ
+/// \param value 滻ֵ
+void RenderContext::set( const string &name, const bool value ) {
+	if ( name == "" )
+		return;
+
+	size_t slot = this->var( name );
+	_sets[slot].clear();
+	_vars[slot].type = TMPL_V_BOOL;
+	_vars[slot].num = value ? 1 : 0;
+}
+
+/// Ʊ
+/// ȲҰ󶨵ģű,ٲģûе
+/// \param name 
+/// \return Ʊ,Ʋڷ-1
+int RenderContext::find( const string &name ) const {
+	if ( _symbols != 0 ) {
+		int slot = _symbols->find( name );
+		if ( slot != -1 )
+			return slot;
+	}
+	map<string,int>::const_iterator i = _others.find( name );
+	if ( i != _others.end() )
+		return i->second;
+	return -1;
+}
+
+/// Ʊ,Ʋʱ
+/// ģűûеֻӵ,滻ʱɾ
+/// \param name 
+/// \return Ʊ
+size_t RenderContext::slot( const string &name ) {
+	int slot = this->find( name );
+	if ( slot != -1 )
+		return slot;
+
+	slot = ( _symbols!=0 ? _symbols->size() : 0 ) + _others.size();
+	_others[name] = slot;
+	return slot;
+}
+
+/// رŶӦ
+/// \param slot Ʊ
+/// \return ,Ųڷؿַ
+string RenderContext::name( const size_t slot ) const {
+	if ( _symbols!=0 && slot<static_cast<size_t>(_symbols->size()) )
+		return _symbols->name( slot );
+	for ( map<string,int>::const_iterator i=_others.begin(); i!=_others.end(); ++i ) {
+		if ( static_cast<size_t>(i->second) == slot )
+			return i->first;
+	}
+	return "";
+}
+
+/// ģ
+/// õ滻ѭģķű±,ģʱֱӶȡ,
+/// 󶨻ģʱڿʼʱƲһ
+/// \param tmpl ģ
+void RenderContext::bind( const CompiledTemplate &tmpl ) {
+	this->bind( tmpl._symbols );
+}
+
+/// ģű
+/// \param symbols ģű,Ϊ0ʱȡ
+void RenderContext::bind( const TemplateSymbol *symbols ) {
+	if ( symbols == _symbols )
+		return;
+
+	// names of current slots
+	size_t count = ( _symbols!=0 ? _symbols->size() : 0 );
+	strings names( count+_others.size() );
+	for ( size_t i=0; i<count; ++i )
+		names[i] = _symbols->name( i );
+	for ( map<string,int>::const_iterator i=_others.begin(); i!=_others.end(); ++i )
+		names[i->second] = i->first;
+
+	strings sets;
+	vector<tmpl_var> vars;
+	vector<bool> isset;
+	vector<tmpl_loop*> loops;
+	sets.swap( _sets );
+	vars.swap( _vars );
+	isset.swap( _isset );
+	loops.swap( _loops );
+	_others.clear();
+	if ( symbols != 0 )
+		symbols->retain();
+	if ( _symbols != 0 )
+		_symbols->release();
+	_symbols = symbols;
+
+	// move to new slots
+	for ( size_t i=0; i<names.size(); ++i ) {
+		if ( i<isset.size() && isset[i] ) {
+			size_t slot = this->var( names[i] );
+			_sets[slot].swap( sets[i] );
+			_vars[slot] = vars[i];
+		}
+		if ( i<loops.size() && loops[i]!=0 ) {
+			size_t slot = this->slot( names[i] );
+			if ( slot >= _loops.size() )
+				_loops.resize( slot+1, 0 );
+			_loops[slot] = loops[i];
+		}
+	}
+	for ( size_t i=0; i<_loops.size(); ++i ) {
+		if ( _loops[i] != 0 )
+			this->index_fields( *_loops[i] );
+	}
+}
+
+/// ѭֶλ
+/// \param data ѭ
+void RenderContext::index_fields( tmpl_loop &data ) {
+	data.fieldspos.clear();
+	for ( size_t i=0; i<data.fields.size(); ++i ) {
+		if ( data.fields[i] != "" ) {
+			size_t slot = this->slot( data.fields[i] );
+			if ( slot >= data.fieldspos.size() )
+				data.fieldspos.resize( slot+1, -1 );
+			data.fieldspos[slot] = i;
+		}
+	}
+}
+
+/// 滻ֵλ
+/// 滻ֵбռ䲻ʱչ,ģΪ
+/// \param name ģ
+/// \return 滻ֵλ
+size_t RenderContext::var( const string &name ) {
+	size_t slot = this->slot( name );
+	if ( slot >= _sets.size() ) {
+		size_t size = max( slot+1, static_cast<size_t>(_symbols!=0 ? _symbols->size() : 0) );
+		tmpl_var var = { TMPL_V_TEXT, 0, 0, 0 };
+		_sets.resize( size );
+		_vars.resize( size, var );
+		_isset.resize( size, false );
+	}
+	_isset[slot] = true;
+	return slot;
+}
+
+/// ʽ滻ֵ
+/// ʽitos(),ftos()ͬ
+/// \param var 滻ֵ
+/// \param buf ظʽ
+void RenderContext::format( const tmpl_var &var, string &buf ) {
+	char str[64];
+	int len;
+	if ( var.type == TMPL_V_REAL ) {
+		len = snprintf( str, sizeof(str), "%.*f", var.ndigit, var.real );
+		if ( len >= static_cast<int>(sizeof(str)) ) {
+			buf = ftos( var.real, var.ndigit );
+			return;
+		}
+	} else {
+		len = snprintf( str, sizeof(str), "%ld", var.num );
+	}
+	buf.assign( str, len );
+}
+
+/// ѭ
+/// ѭʱ
+/// \param loop ѭ
+/// \return ѭ
+RenderContext::tmpl_loop* RenderContext::loop( const string &loop ) {
+	size_t slot = this->slot( loop );
+	if ( slot >= _loops.size() )
+		_loops.resize( slot+1, 0 );
+	if ( _loops[slot] == 0 ) {
+		_loops[slot] = new tmpl_loop;
+		_loops[slot]->cols = 0;
+		_loops[slot]->rows = 0;
+		_loops[slot]->source = 0;
+		_loops[slot]->owned = 0;
+		_loops[slot]->generator = 0;
+	}
+	return _loops[slot];
+}
+
+/// ؿݵѭ
+/// \param loop ѭ
+/// \param func ú,ڴ¼
+/// \return ѭ,ѭδѰԴ0
+RenderContext::tmpl_loop* RenderContext::append_loop( const string &loop, const char *func ) {
+	tmpl_loop *data = this->loop( this->find(loop) );
+	if ( data == 0 ) {
+		this->error_log( 0, "Error: Call def_loop() to init $"+loop+" first, in "+func+"()" );
+		return 0;
+	}
+	if ( data->source != 0 ) {
+		this->error_log( 0, "Error: Loop $"+loop+" is bound to rows source, in "+func+"()" );
+		return 0;
+	}
+	return data;
+}
+
+/// ½ѭ
+/// \param loop ѭ
+/// \param field_0 field_0field_0֮Ϊֶб,һNULL
+/// \param ... ֶб,һNULL
+void RenderContext::def_loop( const string &loop, const char* field_0, ... ) {
+	va_list ap;
+	const char *p;
+	string field;
+	strings fields;
+	size_t cols = 0;
+	
+	// check same name loop
+	int slot = this->find( loop );
+	if ( this->loop(slot) != 0 )
+		this->error_log( 0, "Warning: loop name \""+loop+"\" redefined" );
+	
+	// get fields
+	tmpl_loop &data = *this->loop( loop );
+	va_start( ap, field_0 );
+	for ( p=field_0; p; p=va_arg(ap,const char*) ) {
+		if ( (field=p) != "" ) {
+			fields.push_back( field );
+			++cols;
+		}
+	}
+	va_end( ap );
+
+	// for waTemplate old version templet script ( < v0.7 )
+	slot = this->slot( loop );
+	if ( static_cast<size_t>(slot)>=_isset.size() || !_isset[slot] )
+		set( loop, loop );
+
+	// init loop
+	delete data.owned;
+	data.owned = 0;
+	data.source = 0;
+	data.generator = 0;
+	data.fields = fields;
+	this->index_fields( data );
+	data.arena.clear();
+	data.columns.clear();
+	data.columns.resize( cols );
+	data.rows = 0;
+	data.cols = cols;
+}
+
+/// һݵѭ
+/// ȵRenderContext::def_loop()ʼѭֶζ,ֹ
+/// \param loop ѭ
+/// \param value_0 value_0value_0֮Ϊֶб,һNULL
+/// \param ... ֶб,һNULL
+void RenderContext::append_row( const string &loop, const char* value_0, ... ) {
+	// loop must exist
+	tmpl_loop *found = this->append_loop( loop, "append_row" );
+	if ( found == 0 )
+		return;
+	tmpl_loop &data = *found;
+	
+	// get values
+	va_list ap;
+	const char *p;
+	int cols = 0;
+	
+	va_start( ap, value_0 );
+	for ( p=value_0; p; p=va_arg(ap,const char*) ) {
+		this->append_cell( data, cols, p, strlen(p) );
+		++cols;
+		
+		// enough now
+		if ( cols >= data.cols )
+			break;
+	}
+	va_end( ap );
+
+	// fill blank if not enough
+	this->append_end( data, cols );
+}
+
+/// һָʽݵѭ
+/// ȵRenderContext::def_loop()ʼѭֶζ,ֹ
+/// \param loop ѭ
+/// \param format ֶѭʽ,"%d,%s,..."ʽ
+/// \param ... Ϊֵֶб,
+/// ֵֶڸʽformatָĸ
+void RenderContext::append_format( const string &loop, const char* format, ... ) {
+	// loop must exist
+	tmpl_loop *found = this->append_loop( loop, "append_format" );
+	if ( found == 0 )
+		return;
+	tmpl_loop &data = *found;
+	
+	// split format string
+	String fmtstr = format;
+	vector<String> fmtlist = fmtstr.split( TMPL_SPLIT );
+	
+	// get values
+	va_list ap;
+	string value;
+	int cols = 0;
+	
+	va_start( ap, format );
+	for ( size_t i=0; i<fmtlist.size(); ++i ) {
+		// read and push data
+		fmtlist[i].trim();
+		if ( fmtlist[i] == TMPL_FMTSTR ) {
+			const char *p = va_arg( ap, const char* ); // %s
+			this->append_cell( data, cols, p, strlen(p) );
+		} else {
+			value = itos( va_arg(ap,long) ); // %d or other
+			this->append_cell( data, cols, value.data(), value.length() );
+		}
+		++cols;
+
+		// enough now
+		if ( cols >= data.cols )
+			break;
+	}
+	va_end( ap );
+
+	// fill blank if not enough
+	this->append_end( data, cols );
+}
+
+/// һݵѭ
+/// ȵRenderContext::def_loop()ʼѭֶζ,ֹ
+/// \param loop ѭ
+/// \param values ֵֶб,ֶĲֺ,ʱַ
+void RenderContext::append_row( const string &loop, const vector<string> &values ) {
+	tmpl_loop *found = this->append_loop( loop, "append_row" );
+	if ( found == 0 )
+		return;
+
+	int cols = min( values.size(), static_cast<size_t>(found->cols) );
+	for ( int i=0; i<cols; ++i )
+		this->append_cell( *found, i, values[i].data(), values[i].length() );
+	this->append_end( *found, cols );
+}
+
+/// Ӷݵѭ
+/// ȵRenderContext::def_loop()ʼѭֶζ,ֹ
+/// \param loop ѭ
+/// \param rows б,ÿΪֵֶб
+void RenderContext::append_rows( const string &loop, const vector< vector<string> > &rows ) {
+	tmpl_loop *found = this->append_loop( loop, "append_rows" );
+	if ( found == 0 )
+		return;
+
+	for ( int i=0; i<found->cols; ++i )
+		found->columns[i].reserve( found->rows+rows.size() );
+	for ( size_t r=0; r<rows.size(); ++r ) {
+		const strings &values = rows[r];
+		int cols = min( values.size(), static_cast<size_t>(found->cols) );
+		for ( int i=0; i<cols; ++i )
+			this->append_cell( *found, i, values[i].data(), values[i].length() );
+		this->append_end( *found, cols );
+	}
+}
+
+/// Ӷݵѭ
+/// ȵRenderContext::def_loop()ʼѭֶζ,ֹ,
+/// ֱӸƵѭݻ,ʱַ
+/// \param loop ѭ
+/// \param values ,˳򱣴,ÿΪֶ,
+/// rows*ֶԪ,ΪNULLԪΪַ
+/// \param rows 
+/// \param lengths ݳ,valuesһһӦ,ĬΪ0ʹstrlen()㳤
+void RenderContext::append_rows( const string &loop, const char* const *values,
+	const size_t rows, const size_t *lengths )
+{
+	tmpl_loop *found = this->append_loop( loop, "append_rows" );
+	if ( found == 0 )
+		return;
+
+	int cols = found->cols;
+	for ( int i=0; i<cols; ++i )
+		found->columns[i].reserve( found->rows+rows );
+	for ( size_t r=0; r<rows; ++r ) {
+		for ( int i=0; i<cols; ++i ) {
+			size_t n = r*cols + i;
+			const char *val = values[n] ? values[n] : "";
+			size_t len = lengths ? lengths[n] : strlen( val );
+			this->append_cell( *found, i, val, values[n] ? len : 0 );
+		}
+		++found->rows;
+	}
+}
+
+/// Ԥѭݿռ
+/// ȵRenderContext::def_loop()ʼѭֶζ,
+/// Ӵǰ,ʱظڴ
+/// \param loop ѭ
+/// \param rows Ԥ
+/// \param bytes Ԥܳ,ĬΪ0Ԥ
+void RenderContext::reserve_rows( const string &loop, const size_t rows, const size_t bytes ) {
+	tmpl_loop *found = this->loop( this->find(loop) );
+	if ( found==0 || found->source!=0 )
+		return;
+
+	for ( int i=0; i<found->cols; ++i )
+		found->columns[i].reserve( rows );
+	if ( bytes > 0 )
+		found->arena.reserve( bytes );
+}
+
+/// ѭԴ
+/// ʱֱӶȡԴе,,ֶƼλڰʱȡ,
+/// ʹڼԴ뱣Ч,󶨺ٵappend_row()Ⱥ,
+/// µdef_loop()bind_loop()ʱ
+/// \param loop ѭ
+/// \param rows ѭԴ
+void RenderContext::bind_loop( const string &loop, const TemplateRows &rows ) {
+	this->bind_loop( loop, &rows, 0 );
+}
+
+/// ѭ
+/// ѭʱTemplateGenerator::fetch()жȡ,ֱfalse,
+/// ֻģʹ%ROWSʱȡ,
+/// ʹڼ뱣Ч,󶨺RenderContextͬʱڶ̵߳
+/// \param loop ѭ
+/// \param generator ѭ
+void RenderContext::bind_loop( const string &loop, TemplateGenerator &generator ) {
+	this->bind_loop( loop, &generator, 0, &generator );
+}
+
+#ifndef _WEBAPPLIB_NOMYSQL
+/// MysqlDataݼѭ
+/// ʱֱӶȡMYSQL_ROW,мַ,ֶΪݼֶ,
+/// ʹڼMysqlData뱣ЧҲٴڲѯ
+/// \param loop ѭ
+/// \param data MysqlDataݼ
+void RenderContext::bind_loop( const string &loop, MysqlData &data ) {
+	MysqlRows *rows = new MysqlRows( data );
+	this->bind_loop( loop, rows, rows );
+}
+#endif
+
+/// ѭԴ
+/// \param loop ѭ
+/// \param rows ѭԴ
+/// \param owned RenderContextɾѭԴ,Ϊ0
+/// \param generator ѭ,ʱȡ,ʱΪ0
+void RenderContext::bind_loop( const string &loop, const TemplateRows *rows,
+	TemplateRows *owned, TemplateGenerator *generator )
+{
+	tmpl_loop &data = *this->loop( loop );
+	size_t cols = rows->cols();
+
+	// fields
+	data.fields.clear();
+	for ( size_t i=0; i<cols; ++i )
+		data.fields.push_back( rows->field(i) );
+	this->index_fields( data );
+
+	// for waTemplate old version templet script ( < v0.7 )
+	size_t slot = this->slot( loop );
+	if ( slot>=_isset.size() || !_isset[slot] )
+		set( loop, loop );
+
+	// bind
+	if ( data.owned != owned )
+		delete data.owned;
+	data.owned = owned;
+	data.source = rows;
+	data.generator = generator;
+	data.arena.clear();
+	data.columns.clear();
+	data.cols = cols;
+	data.rows = 0;
+	if ( generator == 0 ) {
+		size_t count = rows->rows();
+		if ( count != TMPL_ROWS_UNKNOWN )
+			data.rows = count;
+	}
+}
+
+/// 滻
+/// ѭ滻,ϲе滻
+void RenderContext::clear_set() {
+	_others.clear();
+	_sets.clear();
+	_vars.clear();
+	_isset.clear();
+	for ( size_t i=0; i<_loops.size(); ++i ) {
+		if ( _loops[i] != 0 )
+			delete _loops[i]->owned;
+		delete _loops[i];
+	}
+	_loops.clear();
+}
+
+/// ϲ
+/// δõ滻δѭϲжȡ,ϲݿָϲ,
+/// ʹõ(ȫ֡վ)Ϊϲݹ,ÿֻñ仯
+/// \param parent ϲ,,ʹڼ뱣ЧҲ޸,Ϊ0ʱȡ
+void RenderContext::set_parent( const RenderContext *parent ) {
+	// avoid loop
+	for ( const RenderContext *ctx=parent; ctx!=0; ctx=ctx->_parent ) {
+		if ( ctx == this )
+			return;
+	}
+	_parent = parent;
+}
+
+/// ѭΪJSON
+/// HTMLģʹͬѭ,ʽΪ[{"field_0":"value_0",...},...]
+/// \param loop ѭ
+/// \param json JSON,ѭʱ
+void RenderContext::json( const string &loop, Json &json ) const {
+	const tmpl_loop *data = 0;
+	for ( const RenderContext *ctx=this; ctx!=0 && data==0; ctx=ctx->_parent )
+		data = ctx->loop( ctx->find(loop) );
+	json.begin_array();
+	if ( data != 0 ) {
+		const char *val;
+		size_t len;
+		for ( int r=0; data->generator ? data->generator->fetch(r) : r<data->rows; ++r ) {
+			json.begin_object();
+			for ( int i=0; i<data->cols; ++i ) {
+				json.key( data->fields[i] );
+				val = RenderContext::cell( *data, i, r, len );
+				json.value( val, len );
+			}
+			json.end_object();
+		}
+	}
+	json.end_array();
+}
+
+/// ô¼
+/// \param lines ģλ
+/// \param error 
+void RenderContext::error_log( const size_t lines, const string &error ) {
+	if ( error != "" )
+		_errlog.insert( multimap<int,string>::value_type(lines,error) );
+}
+
+////////////////////////////////////////////////////////////////////////////
+// sink functions
+
+#ifdef IOV_MAX
+const size_t FDSINK_IOV_MAX = IOV_MAX;
+#else
+const size_t FDSINK_IOV_MAX = 16;
+#endif
+
+/// 캯
+/// \param fd ļ
+/// \param buffer ݻС,ڸƲܱЧ,ĬΪ16384
+/// \param flush_size дݴﵽóʱд,ĬΪ0ֻڻʱд
+FdSink::FdSink( const int fd, const size_t buffer, const size_t flush_size ):
+_fd(fd), _size(buffer>0?buffer:1), _used(0), _flush_size(flush_size), 
+_pending(0), _bytes(0), _failed(false)
+{
+	_buf = new char[_size];
+	_iov.reserve( FDSINK_IOV_MAX );
+}
+
+/// 
+/// дδд
+FdSink::~FdSink() {
+	this->flush();
+	delete[] _buf;
+}
+
+/// ݶ
+/// һʱϲ
+/// \param data ݿʼλ
+/// \param len ݳ
+void FdSink::append( const char *data, const size_t len ) {
+	if ( !_iov.empty() ) {
+		struct iovec &last = _iov.back();
+		if ( static_cast<const char*>(last.iov_base)+last.iov_len == data ) {
+			last.iov_len += len;
+			return;
+		}
+	}
+
+	struct iovec iov;
+	iov.iov_base = const_cast<char*>( data );
+	iov.iov_len = len;
+	_iov.push_back( iov );
+}
+
+/// 
+/// \param data ݿʼλ
+/// \param len ݳ
+/// \param stable ڱģǰǷ񱣳Ч,ΪfalseʱƵݻ
+void FdSink::write( const char *data, const size_t len, const bool stable ) {
+	if ( len==0 || _failed )
+		return;
+
+	if ( !stable ) {
+		if ( len > _size-_used )
+			this->flush();
+		if ( len <= _size-_used ) {
+			// copy to buffer
+			memcpy( _buf+_used, data, len );
+			this->append( _buf+_used, len );
+			_used += len;
+		} else {
+			// too large, write now
+			this->append( data, len );
+			this->flush();
+			return;
+		}
+	} else {
+		this->append( data, len );
+	}
+
+	_pending += len;
+	if ( _iov.size()>=FDSINK_IOV_MAX || (_flush_size>0 && _pending>=_flush_size) )
+		this->flush();
+}
+
+/// дļ
+/// ʹwritev()дддݶ,д뼰EINTR
+void FdSink::flush() {
+	size_t i = 0;
+	while ( i<_iov.size() && !_failed ) {
+		int count = min( _iov.size()-i, FDSINK_IOV_MAX );
+		ssize_t n = writev( _fd, &_iov[i], count );
+		if ( n < 0 ) {
+			if ( errno == EINTR )
+				continue;
+			_failed = true;
+			break;
+		}
+		_bytes += n;
+
+		// skip written
+		size_t written = n;
+		while ( i<_iov.size() && written>=_iov[i].iov_len ) {
+			written -= _iov[i].iov_len;
+			++i;
+		}
+		if ( written > 0 ) {
+			_iov[i].iov_base = static_cast<char*>( _iov[i].iov_base ) + written;
+			_iov[i].iov_len -= written;
+		}
+	}
+
+	_iov.clear();
+	_used = 0;
+	_pending = 0;
+}
+
+/// 
+/// ǰchunkﵽֵʱ
+/// \param data ݿʼλ
+/// \param len ݳ
+/// \param stable ڱģǰǷ񱣳Ч,ΪfalseʱƵ
+void ChunkedSink::write( const char *data, const size_t len, const bool stable ) {
+	if ( len==0 || _finished )
+		return;
+
+	chunk_seg seg;
+	seg.data = stable ? data : 0;
+	seg.pos = _buf.length();
+	seg.len = len;
+	if ( !stable )
+		_buf.append( data, len );
+	_segs.push_back( seg );
+
+	_pending += len;
+	if ( _pending >= _chunk_size )
+		this->chunk();
+}
+
+/// chunk
+/// chunkȼݶд¼ӿ
+void ChunkedSink::chunk() {
+	if ( _pending == 0 )
+		return;
+
+	char head[32];
+	int len = snprintf( head, 32, "%lx\r\n", static_cast<unsigned long>(_pending) );
+	_output.write( head, len, false );
+	for ( size_t i=0; i<_segs.size(); ++i ) {
+		const chunk_seg &seg = _segs[i];
+		if ( seg.data != 0 )
+			_output.write( seg.data, seg.len, true );
+		else
+			_output.write( _buf.data()+seg.pos, seg.len, false );
+	}
+	_output.write( "\r\n", 2, true );
+
+	_segs.clear();
+	_buf.clear();
+	_pending = 0;
+}
+
+/// chunkˢ¼ӿ
+void ChunkedSink::flush() {
+	this->chunk();
+	_output.flush();
+}
+
+/// chunk,ֿ鴫
+/// ֮ݱ
+void ChunkedSink::finish() {
+	if ( _finished )
+		return;
+	this->chunk();
+	_output.write( "0\r\n\r\n", 5, true );
+	_output.flush();
+	_finished = true;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// render functions
+
+/// ʼݲ
+/// δ󶨱ģݲ㰴Ʋһ,ʱŶȡ
+/// \param st 
+/// \param ctx 
+void CompiledTemplate::init_scopes( tmpl_state &st, const RenderContext &ctx ) const {
+	st.ctx = &ctx;
+	for ( const RenderContext *scope=&ctx; scope!=0; scope=scope->_parent ) {
+		st.scopes.push_back( tmpl_scope() );
+		tmpl_scope &level = st.scopes.back();
+		level.ctx = scope;
+		level.bound = ( scope->_symbols == _symbols );
+		if ( level.bound )
+			continue;
+
+		level.slots.resize( _symbols->size(), -1 );
+		if ( scope->_symbols == 0 ) {
+			// all names are local
+			for ( map<string,int>::const_iterator i=scope->_others.begin(); i!=scope->_others.end(); ++i ) {
+				int slot = _symbols->find( i->first );
+				if ( slot != -1 )
+					level.slots[slot] = i->second;
+			}
+		} else {
+			for ( int i=0; i<_symbols->size(); ++i )
+				level.slots[i] = scope->find( _symbols->name(i) );
+		}
+	}
+}
+
+/// ģ嵽
+/// \param ctx 
+/// \param output 
+/// \param errlog ¼,ĬΪ0¼
+void CompiledTemplate::render( const RenderContext &ctx, ostream &output,
+	multimap<int,string> *errlog ) const
+{
+	OstreamSink sink( output );
+	this->render( ctx, sink, errlog );
+}
+
+/// ģ
+/// ˳ģıʽֵ,ģıݲ,
+/// ֻȡģ弰,ݱڵջ,
+/// ߳̿ͬʱʹͬһCompiledTemplateRenderContext,Ҫ
+/// \param ctx 
+/// \param output 
+/// \param errlog ¼,ĬΪ0¼
+void CompiledTemplate::render( const RenderContext &ctx, TemplateSink &output,
+	multimap<int,string> *errlog ) const
+{
+	tmpl_state st;
+	this->init_scopes( st, ctx );
+	st.errlog = errlog;
+	st.loop = -1;
+	st.cursor = 0;
+	st.data = 0;
+	st.owner = 0;
+	st.lines = 0;
+	st.stable = true;
+
+	// confirm if inited
+	if ( _code.empty() ) {
+		this->render_log( st, "Error: Templet not initialized" );
+		return;
+	}
+
+	// init datetime
+	struct tm stm;
+	time_t tt = time( 0 );
+	localtime_r( &tt, &stm );
+	snprintf( st.date, 15, "%d-%d-%d", stm.tm_year+1900, stm.tm_mon+1, stm.tm_mday );
+	snprintf( st.time, 15, "%d:%d:%d", stm.tm_hour, stm.tm_min, stm.tm_sec );
+
+	this->execute( st, output, 0, _code.size() );
+	output.flush();
+}
+
+/// ִģָ
+/// \param st 
+/// \param output ģ
+/// \param pc ʼָλ
+/// \param end ָλ,
+void CompiledTemplate::execute( tmpl_state &st, TemplateSink &output, size_t pc,
+	const size_t end ) const
+{
+	while ( pc < end ) {
+		const tmpl_inst &inst = _code[pc];
+		st.lines = inst.line;
+
+		// execute by script type
+		switch ( inst.type ) {
+			case TMPL_S_TEXT:
+				// html
+				this->write( st, output, _text.data()+inst.pos, inst.len, true );
+				++pc;
+				break;
+
+			case TMPL_S_VALUE:
+				// replace
+			case TMPL_S_LOOPVALUE:
+				// replace with loop value
+			case TMPL_S_CURSOR:
+				// replace with cursor
+			case TMPL_S_ROWS:
+				// replace with rows
+			case TMPL_S_DATE:
+				// replace with date
+			case TMPL_S_TIME:
+				// replace with time
+			case TMPL_S_SPACE:
+				// replace with space char
+			case TMPL_S_BLANK: {
+				// replace with blank string
+				size_t len;
+				const char *val = this->value( st, inst.val, len );
+				this->write( st, output, val, len, st.stable );
+				++pc;
+				}
+				break;
+
+			case TMPL_S_IF:
+				// condition, jump to next branch if false
+				if ( this->check_if(st,inst.cond) )
+					++pc;
+				else
+					pc = this->branch( st, inst.jump );
+				break;
+
+			case TMPL_S_ELSIF:
+			case TMPL_S_ELSE:
+				// end of effected branch
+				pc = inst.end+1;
+				break;
+
+			case TMPL_S_ENDIF:
+				++pc;
+				break;
+
+			case TMPL_S_FLUSH:
+				// write buffered output
+				output.flush();
+				++pc;
+				break;
+
+			case TMPL_S_CACHE: {
+				// fragment cache, skip block if cached
+				size_t len;
+				const char *val = this->value( st, inst.val, len );
+				if ( len == 0 ) {
+					// no key, not cached
+					++pc;
+					break;
+				}
+				string key( val, len );
+				st.fragments.push_back( string() );
+				string &cached = st.fragments.back();
+				if ( FragmentCache::instance().get(key,cached) ) {
+					this->write( st, output, cached.data(), cached.length(), true );
+					pc = inst.jump+1;
+					break;
+				}
+				st.fragments.pop_back();
+
+				// capture block output
+				tmpl_capture capture;
+				capture.end = inst.jump;
+				capture.key = key;
+				capture.ttl = inst.ttl;
+				st.captures.push_back( capture );
+				++pc;
+				}
+				break;
+
+			case TMPL_S_ENDCACHE:
+				// save captured output
+				if ( !st.captures.empty() && st.captures.back().end==pc ) {
+					const tmpl_capture &capture = st.captures.back();
+					FragmentCache::instance().set( capture.key, capture.data, capture.ttl );
+					st.captures.pop_back();
+				}
+				++pc;
+				break;
+
+			case TMPL_S_LOOP: {
+				// cycle, jump over if no data
+				int loop = this->scope( st, inst.val );
+				int owner = 0;
+				const RenderContext::tmpl_loop *data = this->loop( st, loop, owner );
+				if ( data==0 || !this->fetch(st,loop,data,0) ) {
+					size_t len;
+					const char *val = this->value( st, inst.val, len );
+					this->render_log( st, "Warning: loop " + inst.exp + " \""+
+						string(val,len)+"\" not defined or not set data" );
+					pc = inst.jump+1;
+					break;
+				}
+
+				// large loop, render slices in parallel
+				if ( this->parallel(st,output,pc,loop,data,owner) ) {
+					pc = inst.jump+1;
+					break;
+				}
+
+				// backup parent loop status
+				tmpl_frame frame;
+				frame.loop = st.loop;
+				frame.cursor = st.cursor;
+				st.frames.push_back( frame );
+
+				st.loop = loop;
+				st.data = data;
+				st.owner = owner;
+				st.cursor = 0;
+				if ( static_cast<size_t>(loop) >= st.cursors.size() )
+					st.cursors.resize( loop+1, 0 );
+				st.cursors[loop] = 0;
+				++pc;
+				}
+				break;
+
+			case TMPL_S_ENDLOOP:
+				// at the end of this cycle
+				++st.cursor;
+				st.cursors[st.loop] = st.cursor;
+				if ( inst.jump!=pc && this->fetch(st,st.loop,st.data,st.cursor) ) {
+					// next cycle
+					pc = inst.jump+1;
+				} else {
+					// restore parent loop status
+					st.loop = st.frames.back().loop;
+					st.cursor = st.frames.back().cursor;
+					st.data = this->loop( st, st.loop, st.owner );
+					st.frames.pop_back();
+					if ( st.loop != -1 )
+						st.cursors[st.loop] = st.cursor;
+					++pc;
+				}
+				break;
+
+			default:
+				++pc;
+		}
+	}
+}
+
+/// ѭ
+/// ѭа˳Ϊ,TemplatePool̳߳е̷ֱ߳ԵĻ,
+/// ÿʹöݼѭ,%CURSOR˳ͬ,ȫɺ˳,
+/// ѭԴcell()ͬʱڶ߳е,
+/// ʹѭ{{#CACHE}}{{#FLUSH}}{{#CACHE}}еѭ˳
+/// \param st 
+/// \param output ģ
+/// \param pc #FORָλ
+/// \param loop ѭƱ
+/// \param data ѭ
+/// \param owner ѭڵݲ
+/// \retval true Ѳ
+/// \retval false ܲ,Ҫ˳
+bool CompiledTemplate::parallel( tmpl_state &st, TemplateSink &output, const size_t pc,
+	const int loop, const RenderContext::tmpl_loop *data, const int owner ) const
+{
+	const RenderContext &ctx = *st.ctx;
+	const tmpl_inst &inst = _code[pc];
+
+	// slices
+	int min_rows = ctx.parallel();
+	if ( min_rows<=0 || data->generator!=0 || !st.captures.empty() )
+		return false;
+	int threads = TemplatePool::instance().threads();
+	int count = min( threads+1, data->rows/min_rows );
+	if ( threads<=0 || count<2 || _code[inst.jump].jump==inst.jump )
+		return false;
+
+	// reading generator
+	for ( size_t i=0; i<st.fetched.size(); ++i ) {
+		if ( st.fetched[i] != -1 )
+			return false;
+	}
+
+	// shared state in loop
+	for ( size_t i=pc+1; i<inst.jump; ++i ) {
+		const tmpl_inst &body = _code[i];
+		switch ( body.type ) {
+			case TMPL_S_CACHE:
+			case TMPL_S_ENDCACHE:
+			case TMPL_S_FLUSH:
+				return false;
+			case TMPL_S_LOOP:
+				if ( this->generated(st,body.val) )
+					return false;
+				break;
+			case TMPL_S_LOOPVALUE:
+			case TMPL_S_CURSOR:
+			case TMPL_S_ROWS:
+				if ( this->generated(st,_values[body.val].scope) )
+					return false;
+				break;
+			case TMPL_S_IF:
+			case TMPL_S_ELSIF: {
+				const vector<tmpl_cmp> &items = _conds[body.cond].items;
+				for ( size_t n=0; n<items.size(); ++n ) {
+					if ( this->generated(st,_values[items[n].lhs].scope) 
+						|| (items[n].rhs!=-1 && this->generated(st,_values[items[n].rhs].scope)) )
+						return false;
+				}
+				}
+				break;
+		}
+	}
+
+	// render
+	vector<tmpl_slice> slices( count );
+	vector<void*> args( count );
+	for ( int i=0; i<count; ++i ) {
+		tmpl_slice &slice = slices[i];
+		slice.tmpl = this;
+		slice.pc = pc;
+		slice.begin = static_cast<long>(data->rows) * i / count;
+		slice.end = static_cast<long>(data->rows) * (i+1) / count;
+
+		tmpl_state &ws = slice.st;
+		ws.ctx = st.ctx;
+		ws.scopes = st.scopes;
+		ws.names = st.names;
+		ws.loop = loop;
+		ws.cursor = slice.begin;
+		ws.data = data;
+		ws.owner = owner;
+		ws.cursors = st.cursors;
+		if ( static_cast<size_t>(loop) >= ws.cursors.size() )
+			ws.cursors.resize( loop+1, 0 );
+		ws.fetched = st.fetched;
+		ws.lines = st.lines;
+		memcpy( ws.date, st.date, sizeof(ws.date) );
+		memcpy( ws.time, st.time, sizeof(ws.time) );
+		ws.stable = true;
+		ws.errlog = ( st.errlog!=0 ) ? &slice.errlog : 0;
+		args[i] = &slice;
+	}
+	TemplatePool::instance().run( CompiledTemplate::render_slice, &args[0], count );
+
+	// output in order
+	for ( int i=0; i<count; ++i ) {
+		st.fragments.push_back( string() );
+		st.fragments.back().swap( slices[i].output );
+		output.write( st.fragments.back().data(), st.fragments.back().length(), true );
+		if ( st.errlog != 0 )
+			st.errlog->insert( slices[i].errlog.begin(), slices[i].errlog.end() );
+	}
+
+	// loop finished
+	if ( static_cast<size_t>(loop) >= st.cursors.size() )
+		st.cursors.resize( loop+1, 0 );
+	st.cursors[loop] = data->rows;
+	return true;
+}
+
+/// ѭһ
+/// TemplatePoolִ̳߳
+/// \param arg ѭ,tmpl_slice
+void CompiledTemplate::render_slice( void *arg ) {
+	tmpl_slice *slice = static_cast<tmpl_slice*>( arg );
+	const CompiledTemplate *tmpl = slice->tmpl;
+	size_t end = tmpl->_code[slice->pc].jump;
+	tmpl_state &st = slice->st;
+	StringSink output( slice->output );
+
+	for ( int row=slice->begin; row<slice->end; ++row ) {
+		st.cursor = row;
+		st.cursors[st.loop] = row;
+		tmpl->execute( st, output, slice->pc+1, end );
+	}
+}
+
+/// Ƿȡѭ
+/// \param st 
+/// \param scope ѭƱʽλ,Ϊ-1
+/// \retval true ѭƲַ,Ϊѭ
+/// \retval false 
+bool CompiledTemplate::generated( const tmpl_state &st, const int scope ) const {
+	if ( scope == -1 )
+		return false;
+	const tmpl_value &v = _values[scope];
+	if ( v.type != TMPL_S_TEXT )
+		return true;
+	int owner;
+	const RenderContext::tmpl_loop *data = this->loop( st, v.slot, owner );
+	return data!=0 && data->generator!=0;
+}
+
+/// ѭƱ
+/// ʱѭƲڷűʱӵ
+/// \param st 
+/// \param val ѭƱʽλ
+/// \return ѭƱ
+int CompiledTemplate::scope( tmpl_state &st, const int val ) const {
+	const tmpl_value &v = _values[val];
+	if ( v.type == TMPL_S_TEXT )
+		return v.slot;
+	size_t len;
+	const char *value = this->value( st, val, len );
+	string name( value, len );
+	int slot = _symbols->find( name );
+	if ( slot != -1 )
+		return slot;
+	vector<string>::const_iterator i = std::find( st.names.begin(), st.names.end(), name );
+	if ( i == st.names.end() )
+		i = st.names.insert( st.names.end(), name );
+	return _symbols->size() + ( i-st.names.begin() );
+}
+
+/// ѭλ
+/// \param st 
+/// \param slot ѭƱ
+/// \return ѭλ,δʼѭ0
+int CompiledTemplate::cursor( const tmpl_state &st, const int slot ) const {
+	if ( slot>=0 && static_cast<size_t>(slot)<st.cursors.size() )
+		return st.cursors[slot];
+	return 0;
+}
+
+/// ȡѭ
+/// ѭȡ,ѭλǷС
+/// \param st 
+/// \param slot ѭƱ
+/// \param data ѭ
+/// \param row λ
+/// \retval true д
+/// \retval false в,ѭ
+bool CompiledTemplate::fetch( tmpl_state &st, const int slot,
+	const RenderContext::tmpl_loop *data, const int row ) const
+{
+	if ( data->generator == 0 )
+		return row < data->rows;
+
+	if ( static_cast<size_t>(slot) >= st.fetched.size() )
+		st.fetched.resize( slot+1, -1 );
+	bool fetched = data->generator->fetch( row );
+	st.fetched[slot] = fetched ? row : -1;
+	return fetched;
+}
+
+/// ѭǷԶȡ
+/// ѭֻܶȡȡɹ
+/// \param st 
+/// \param slot ѭƱ
+/// \param data ѭ
+/// \param row λ
+/// \retval true Զȡ
+/// \retval false ܶȡ
+bool CompiledTemplate::readable( const tmpl_state &st, const int slot,
+	const RenderContext::tmpl_loop *data, const int row ) const
+{
+	if ( data->generator == 0 )
+		return row < data->rows;
+	return slot>=0 && static_cast<size_t>(slot)<st.fetched.size() && st.fetched[slot]==row;
+}
+
+/// رʽֵ
+/// \param st 
+/// \param val ʽλ
+/// \param len ֵ
+/// \return ֵΪñʽֵʼλ,'\0'β,
+/// óֵݻ,´εǰЧ
+const char* CompiledTemplate::value( tmpl_state &st, const int val, size_t &len ) const {
+	const tmpl_value &v = _values[val];
+	st.stable = true;
+
+	switch ( v.type ) {
+		case TMPL_S_VALUE: {
+			// simple value: $xxx, maybe in parent
+			int pos;
+			const RenderContext *scope = this->lookup( st, v.slot, pos );
+			if ( scope != 0 ) {
+				if ( scope->_vars[pos].type != TMPL_V_TEXT ) {
+					// typed value, format now
+					RenderContext::format( scope->_vars[pos], st.buf );
+					st.stable = false;
+					len = st.buf.length();
+					return st.buf.data();
+				}
+				len = scope->_sets[pos].length();
+				return scope->_sets[pos].data();
+			}
+			len = 0;
+			return "";
+			}
+
+		case TMPL_S_LOOPVALUE: {
+			// current value in loop: .$xxx
+			const RenderContext::tmpl_loop *data = st.data;
+			int loop = st.loop;
+			int owner = st.owner;
+			int cursor = st.cursor;
+			if ( v.scope != -1 ) {
+				loop = this->scope( st, v.scope );
+				data = this->loop( st, loop, owner );
+				cursor = this->cursor( st, loop );
+			}
+			if ( data!=0 && this->readable(st,loop,data,cursor) ) {
+				int col = this->column( st, data, owner, v.slot );
+				if ( col != -1 ) {
+					st.stable = ( data->generator == 0 );
+					return RenderContext::cell( *data, col, cursor, len );
+				}
+			}
+			len = 0;
+			return "";
+			}
+
+		case TMPL_S_CURSOR:
+			// current loop cursor: %CURSOR
+			if ( v.scope != -1 )
+				st.buf = itos( this->cursor(st,this->scope(st,v.scope))+1 );
+			else
+				st.buf = itos( st.cursor+1 );
+			st.stable = false;
+			len = st.buf.length();
+			return st.buf.data();
+
+		case TMPL_S_ROWS: {
+			// current loop rows: %ROWS
+			const RenderContext::tmpl_loop *data = st.data;
+			int owner;
+			if ( v.scope != -1 )
+				data = this->loop( st, this->scope(st,v.scope), owner );
+			if ( data!=0 && data->generator!=0 ) {
+				// lazy rows
+				size_t rows = data->generator->rows();
+				st.buf = ( rows!=TMPL_ROWS_UNKNOWN ) ? itos( rows ) : "";
+			} else {
+				st.buf = itos( data ? data->rows : 0 );
+			}
+			st.stable = false;
+			len = st.buf.length();
+			return st.buf.data();
+			}
+
+		case TMPL_S_DATE:
+			// date: %DATE
+			len = strlen( st.date );
+			return st.date;
+
+		case TMPL_S_TIME:
+			// time: %TIME
+			len = strlen( st.time );
+			return st.time;
+
+		default:
+			// string
+			len = v.text.length();
+			return v.text.data();
+	}
+}
+
+/// ֧еһķ֧λ
+/// \param st 
+/// \param pc ʼ#ELSIF,#ELSE#ENDIFָλ
+/// \return ֧ĵһָλ,򷵻#ENDIF֮λ
+size_t CompiledTemplate::branch( tmpl_state &st, size_t pc ) const {
+	while ( _code[pc].type == TMPL_S_ELSIF ) {
+		st.lines = _code[pc].line;
+		if ( this->check_if(st,_code[pc].cond) )
+			return pc+1;
+		pc = _code[pc].jump;
+	}
+	// #ELSE or #ENDIF
+	return pc+1;
+}
+
+/// ȡȽ
+/// ַʹñʱתֵ,ʽֵ
+/// \param st 
+/// \param val ʽλ
+/// \param arg رȽ
+void CompiledTemplate::operand( tmpl_state &st, const int val, tmpl_operand &arg ) const {
+	const tmpl_value &v = _values[val];
+	const RenderContext *scope;
+	int pos;
+	arg.var = 0;
+	arg.isreal = false;
+	st.stable = true;
+
+	if ( v.type == TMPL_S_TEXT ) {
+		// literal
+		arg.str = v.text.data();
+		arg.len = v.text.length();
+		arg.isnum = v.isnum;
+		arg.num = v.num;
+
+	} else if ( v.type==TMPL_S_VALUE && (scope=this->lookup(st,v.slot,pos))!=0
+		&& scope->_vars[pos].type!=TMPL_V_TEXT )
+	{
+		// typed value, format only if compared as string
+		arg.var = &scope->_vars[pos];
+		arg.str = 0;
+		arg.len = 0;
+		arg.isnum = true;
+		arg.isreal = ( arg.var->type == TMPL_V_REAL );
+		arg.num = arg.var->num;
+		arg.real = arg.var->real;
+
+	} else {
+		arg.str = this->value( st, val, arg.len );
+		arg.isnum = tmpl_number( arg.str, arg.len, arg.num );
+	}
+}
+
+/// ȽϱʽǷ
+/// \param st 
+/// \param cmp Ƚϱʽ,
+/// ʽΪַ,ֵΪ""ҲΪ"0"ʱtrue,򷵻false,
+/// ΪȽϱʽ,true,򷵻false
+/// \retval true Ƚϱʽ
+/// \retval false Ƚϱʽ
+bool CompiledTemplate::compare( tmpl_state &st, const tmpl_cmp &cmp ) const {
+	if ( cmp.rhs == -1 ) {
+		// read value, compare and return
+		tmpl_operand val;
+		this->operand( st, cmp.lhs, val );
+		if ( val.var != 0 )
+			return val.isreal ? ( val.real!=0 ) : ( val.num!=0 );
+		if ( val.len!=0 && !(val.len==1 && val.str[0]=='0') )
+			return true;
+		else
+			return false;
+	}
+
+	// read value
+	tmpl_operand lhs, rhs;
+	this->operand( st, cmp.lhs, lhs );
+	if ( !st.stable ) {
+		// rhs may overwrite
+		st.lhs.assign( lhs.str, lhs.len );
+		lhs.str = st.lhs.data();
+	}
+	this->operand( st, cmp.rhs, rhs );
+
+	// compare
+	int res;
+	if ( lhs.isnum && rhs.isnum ) {
+		if ( lhs.isreal || rhs.isreal ) {
+			double lv = lhs.isreal ? lhs.real : lhs.num;
+			double rv = rhs.isreal ? rhs.real : rhs.num;
+			res = ( lv>rv ) ? 1 : ( lv==rv ) ? 0 : -1;
+		} else {
+			res = ( lhs.num>rhs.num ) ? 1 : ( lhs.num==rhs.num ) ? 0 : -1;
+		}
+	} else {
+		// typed value compared with string
+		if ( lhs.var != 0 ) {
+			RenderContext::format( *lhs.var, st.lhs );
+			lhs.str = st.lhs.data();
+			lhs.len = st.lhs.length();
+		}
+		if ( rhs.var != 0 ) {
+			RenderContext::format( *rhs.var, st.buf );
+			rhs.str = st.buf.data();
+			rhs.len = st.buf.length();
+		}
+
+		res = tmpl_strcmp( lhs.str, lhs.len, rhs.str, rhs.len );
+	}
+
+	// return
+	switch ( cmp.op ) {
+		case TMPL_C_EQ:
+			return ( res==0 ) ? true : false;
+		case TMPL_C_NE:
+			return ( res!=0 ) ? true : false;
+		case TMPL_C_LE:
+			return ( res<=0 ) ? true : false;
+		case TMPL_C_LT:
+			return ( res<0 ) ? true : false;
+		case TMPL_C_GE:
+			return ( res>=0 ) ? true : false;
+		case TMPL_C_GT:
+			return ( res>0 ) ? true : false;
+		default:
+			return false;
+	}
+}
+
+/// Ƿ	
+/// ߼㰴˳·ֵ
+/// \param st 
+/// \param cond ʽλ
+/// \retval true ʽ
+/// \retval false ʽ
+bool CompiledTemplate::check_if( tmpl_state &st, const int cond ) const {
+	const tmpl_cond &c = _conds[cond];
+
+	if ( c.logic == TMPL_L_AND ) {
+		// TMPL_AND
+		for ( size_t i=0; i<c.items.size(); ++i ) {
+			if ( !this->compare(st,c.items[i]) )
+				return false;
+		}
+		return true;
+		
+	} else if ( c.logic == TMPL_L_OR ) {
+		// TMPL_OR
+		for ( size_t i=0; i<c.items.size(); ++i ) {
+			if ( this->compare(st,c.items[i]) )
+				return true;
+		}
+		return false;
+
+	} else {
+		// none logic expression
+		return this->compare( st, c.items[0] );
+	}
+}
+
+/// ¼
+/// \param st 
+/// \param error 
+void CompiledTemplate::render_log( tmpl_state &st, const string &error ) const {
+	if ( st.errlog!=0 && error!="" )
+		st.errlog->insert( multimap<int,string>::value_type(st.lines,error) );
+}
+
+////////////////////////////////////////////////////////////////////////////
+// codegen functions
+
+/// ģȽ
+/// ඼ΪʱֱȽ,strcmp()ͬ
+/// \param lhs ֵ
+/// \param rhs Ҳֵ
+/// \return Сڷظ,ȷ0,ڷ
+int tmpl_compare( const string &lhs, const string &rhs ) {
+	long lv, rv;
+	if ( tmpl_number(lhs.data(),lhs.length(),lv) && tmpl_number(rhs.data(),rhs.length(),rv) )
+		return ( lv>rv ) ? 1 : ( lv==rv ) ? 0 : -1;
+	return tmpl_strcmp( lhs.data(), lhs.length(), rhs.data(), rhs.length() );
+}
+
+/// C++б
+static const char* TMPL_CPP_KEYWORDS[] = {
+	"and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case", "catch",
+	"char", "class", "compl", "const", "const_cast", "continue", "default", "delete",
+	"do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern",
+	"false", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable",
+	"namespace", "new", "not", "not_eq", "operator", "or", "or_eq", "private",
+	"protected", "public", "register", "reinterpret_cast", "return", "short", "signed",
+	"sizeof", "static", "static_cast", "struct", "switch", "template", "this", "throw",
+	"true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using",
+	"virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq", 0
+};
+
+/// תΪC++ַ
+/// ASCIIַַתΪ˽ת,кΪڵַ
+/// \param str ַʼλ
+/// \param len ַ
+/// \param indent 
+/// \return C++ַ
+static string tmpl_cstring( const char *str, const size_t len, const string &indent ) {
+	string res = "\"";
+	char oct[8];
+	for ( size_t i=0; i<len; ++i ) {
+		unsigned char c = str[i];
+		switch ( c ) {
+			case '\\':	res += "\\\\";	break;
+			case '"':	res += "\\\"";	break;
+			case '?':	res += "\\?";	break;	// trigraphs
+			case '\t':	res += "\\t";	break;
+			case '\r':	res += "\\r";	break;
+			case '\n':
+				res += "\\n";
+				if ( i+1 < len )
+					res += "\"\n" + indent + "\"";
+				break;
+			default:
+				if ( c<0x20 || c>=0x7F ) {
+					snprintf( oct, sizeof(oct), "\\%03o", c );
+					res += oct;
+				} else {
+					res += c;
+				}
+		}
+	}
+	return res + "\"";
+}
+
+/// ΨһC++ʶ
+/// вڱʶַ滻Ϊ'_',뱣ֻбʶظʱӺ׺
+/// \param scope ʶΧ
+/// \param name 
+/// \param kind ,ͬһΧͬͬʱزͬıʶ
+/// \return C++ʶ
+string TemplateCodegen::ident( const string &scope, const string &name, const string &kind ) {
+	string key = scope + "\n" + kind + "\n" + name;
+	map<string,string>::const_iterator i = _idents.find( key );
+	if ( i != _idents.end() )
+		return i->second;
+
+	string id;
+	for ( size_t n=0; n<name.length(); ++n ) {
+		unsigned char c = name[n];
+		id += ( isalnum(c) && c<0x80 ) ? static_cast<char>(c) : '_';
+	}
+	if ( id=="" || isdigit(id[0]) || id[0]=='_' )
+		id = "v" + id;
+	for ( int k=0; TMPL_CPP_KEYWORDS[k]!=0; ++k ) {
+		if ( id == TMPL_CPP_KEYWORDS[k] ) {
+			id += "_";
+			break;
+		}
+	}
+
+	string unique = id;
+	for ( int n=2; _used.find(scope+"\n"+unique)!=_used.end(); ++n )
+		unique = id + "_" + itos( n );
+	_used[scope+"\n"+unique] = true;
+	_idents[key] = unique;
+	return unique;
+}
+
+/// ɴ¼
+/// \param line ģλ
+/// \param error 
+void TemplateCodegen::error_log( const int line, const string &error ) {
+	_errlog.insert( multimap<int,string>::value_type(line,error) );
+}
+
+/// ѭʶ
+/// ֻ֧Ϊַѭ
+/// \param val ѭƱʽλ
+/// \param line ģ
+/// \return ѭʶ,֧ʱ""
+string TemplateCodegen::loop( const int val, const int line ) {
+	const CompiledTemplate::tmpl_value &v = _code._values[val];
+	if ( v.type!=TMPL_S_TEXT || v.slot<0 ) {
+		this->error_log( line, "Error: Loop name must be a string in generated code" );
+		return "";
+	}
+	if ( _fields.find(v.slot) == _fields.end() ) {
+		_fields[v.slot];
+		_loops.push_back( v.slot );
+		this->ident( "ns", _code._symbols->name(v.slot) + "_row" );
+	}
+	return this->loop_ident( v.slot );
+}
+
+/// ѭݱʶ
+/// \param slot ѭƱ
+/// \return ģݽṹеѭʶ
+string TemplateCodegen::loop_ident( const int slot ) {
+	return this->ident( "data", _code._symbols->name(slot), "loop" );
+}
+
+/// ѭ
+/// \param id ѭʶ
+/// \return ѭ
+string TemplateCodegen::cursor( const string &id ) {
+	_cursors[id] = true;
+	return "c_" + id;
+}
+
+/// ѭֶαʶ
+/// \param loop ѭƱ
+/// \param slot ֶƱ
+/// \return ѭнṹеֶαʶ
+string TemplateCodegen::field( const int loop, const int slot ) {
+	vector<int> &fields = _fields[loop];
+	if ( find(fields.begin(),fields.end(),slot) == fields.end() )
+		fields.push_back( slot );
+	return this->ident( "row\t"+_code._symbols->name(loop), _code._symbols->name(slot) );
+}
+
+/// رʽ
+/// \param val ʽλ
+/// \param line ģ
+/// \param stable رʽֵǰǷ񱣳Ч
+/// \return ΪstringC++ʽ
+string TemplateCodegen::value( const int val, const int line, bool &stable ) {
+	const CompiledTemplate::tmpl_value &v = _code._values[val];
+	stable = false;
+
+	switch ( v.type ) {
+		case TMPL_S_VALUE: {
+			// simple value: $xxx
+			string name = _code._symbols->name( v.slot );
+			if ( _idents.find("data\n\n"+name) == _idents.end() )
+				_vars.push_back( v.slot );
+			stable = true;
+			return "d." + this->ident( "data", name );
+			}
+
+		case TMPL_S_LOOPVALUE: {
+			// current value in loop: .$xxx
+			if ( v.scope == -1 ) {
+				if ( _stack.empty() )
+					return "string()";
+				string id = this->loop_ident( _stack.back() );
+				stable = true;
+				return "d." + id + "[" + this->cursor(id) + "]." + this->field( _stack.back(), v.slot );
+			}
+			string id = this->loop( v.scope, line );
+			if ( id == "" )
+				return "string()";
+			int slot = _code._values[v.scope].slot;
+			string f = this->field( slot, v.slot );
+			string c = this->cursor( id );
+			if ( find(_stack.begin(),_stack.end(),slot) != _stack.end() ) {
+				stable = true;
+				return "d." + id + "[" + c + "]." + f;
+			}
+			return "( " + c + "<d." + id + ".size() ? d." + id + "[" + c + "]." + f + " : string() )";
+			}
+
+		case TMPL_S_CURSOR:
+		case TMPL_S_ROWS: {
+			// current loop cursor: %CURSOR
+			// current loop rows: %ROWS
+			string id;
+			if ( v.scope != -1 ) {
+				id = this->loop( v.scope, line );
+				if ( id == "" )
+					return "string()";
+			} else if ( !_stack.empty() ) {
+				id = this->loop_ident( _stack.back() );
+			}
+			if ( v.type == TMPL_S_CURSOR )
+				return ( id=="" ) ? "string( \"1\" )" : "webapp::itos( static_cast<long>(" + this->cursor(id) + "+1) )";
+			else
+				return ( id=="" ) ? "string( \"0\" )" : "webapp::itos( static_cast<long>(d." + id + ".size()) )";
+			}
+
+		case TMPL_S_DATE:
+			// date: %DATE
+			_date = true;
+			return "string( date_ )";
+
+		case TMPL_S_TIME:
+			// time: %TIME
+			_time = true;
+			return "string( time_ )";
+
+		default:
+			// string
+			return "string( " + tmpl_cstring(v.text.data(),v.text.length(),"") + ", "
+				+ itos(v.text.length()) + " )";
+	}
+}
+
+/// ʽ
+/// \param cond ʽλ
+/// \param line ģ
+/// \return ΪboolC++ʽ
+string TemplateCodegen::cond( const int cond, const int line ) {
+	static const char* ops[] = { "==", "!=", "<=", "<", ">=", ">" };
+	const CompiledTemplate::tmpl_cond &c = _code._conds[cond];
+	string res;
+	bool stable;
+
+	for ( size_t i=0; i<c.items.size(); ++i ) {
+		const CompiledTemplate::tmpl_cmp &cmp = c.items[i];
+		if ( i > 0 )
+			res += ( c.logic==TMPL_L_OR ) ? " || " : " && ";
+		if ( cmp.rhs == -1 ) {
+			res += "webapp::tmpl_istrue( " + this->value(cmp.lhs,line,stable) + " )";
+		} else {
+			res += "webapp::tmpl_compare( " + this->value(cmp.lhs,line,stable) + ", "
+				+ this->value(cmp.rhs,line,stable) + " )" + ops[cmp.op] + "0";
+		}
+	}
+	return ( c.items.size()>1 ) ? "( " + res + " )" : res;
+}
+
+/// ָд
+/// \param output 
+/// \param begin ʼָλ
+/// \param end ָλ,
+/// \param indent 
+void TemplateCodegen::block( ostream &output, const size_t begin, const size_t end,
+	const int indent )
+{
+	const vector<tmpl_inst> &code = _code._code;
+	string tab( indent, '\t' );
+	bool stable;
+
+	size_t pc = begin;
+	while ( pc < end ) {
+		const tmpl_inst &inst = code[pc];
+		switch ( inst.type ) {
+			case TMPL_S_TEXT: {
+				// html
+				string id = "L" + itos( _literals.size() );
+				_literals.push_back( "\tstatic const char " + id + "[] = "
+					+ tmpl_cstring(_code._text.data()+inst.pos,inst.len,"\t\t") + ";\n" );
+				output << tab << "out->write( " << id << ", sizeof(" << id << ")-1, true );\n";
+				++pc;
+				}
+				break;
+
+			case TMPL_S_VALUE:
+			case TMPL_S_LOOPVALUE:
+			case TMPL_S_CURSOR:
+			case TMPL_S_ROWS:
+			case TMPL_S_DATE:
+			case TMPL_S_TIME:
+			case TMPL_S_SPACE:
+			case TMPL_S_BLANK: {
+				// replace
+				string val = this->value( inst.val, inst.line, stable );
+				if ( stable ) {
+					output << tab << "out->write( " << val << ".data(), " << val 
+						<< ".length(), true );\n";
+				} else {
+					output << tab << "{ const string v = " << val 
+						<< "; out->write( v.data(), v.length(), false ); }\n";
+				}
+				++pc;
+				}
+				break;
+
+			case TMPL_S_IF: {
+				// condition and branches
+				output << tab << "if ( " << this->cond(inst.cond,inst.line) << " ) {\n";
+				size_t next = inst.jump;
+				this->block( output, pc+1, next, indent+1 );
+				while ( code[next].type == TMPL_S_ELSIF ) {
+					output << tab << "} else if ( " << this->cond(code[next].cond,code[next].line) << " ) {\n";
+					this->block( output, next+1, code[next].jump, indent+1 );
+					next = code[next].jump;
+				}
+				if ( code[next].type == TMPL_S_ELSE ) {
+					output << tab << "} else {\n";
+					this->block( output, next+1, code[next].jump, indent+1 );
+					next = code[next].jump;
+				}
+				output << tab << "}\n";
+				pc = next+1;
+				}
+				break;
+
+			case TMPL_S_LOOP: {
+				// cycle
+				string id = this->loop( inst.val, inst.line );
+				size_t endloop = inst.jump;
+				if ( id != "" ) {
+					_stack.push_back( _code._values[inst.val].slot );
+					this->cursor( id );
+					if ( code[endloop].jump == endloop ) {
+						// not closed, do not cycle
+						output << tab << "for ( c_" << id << "=0; c_" << id << "<d." << id 
+							<< ".size() && c_" << id << "<1; ++c_" << id << " ) {\n";
+					} else {
+						output << tab << "for ( c_" << id << "=0; c_" << id << "<d." << id 
+							<< ".size(); ++c_" << id << " ) {\n";
+					}
+					this->block( output, pc+1, endloop, indent+1 );
+					output << tab << "}\n";
+					_stack.pop_back();
+				}
+				pc = endloop+1;
+				}
+				break;
+
+			case TMPL_S_FLUSH:
+				// write buffered output
+				output << tab << "out->flush();\n";
+				++pc;
+				break;
+
+			case TMPL_S_CACHE: {
+				// fragment cache
+				string n = itos( _temps++ );
+				string key = this->value( inst.val, inst.line, stable );
+				output << tab << "{\n"
+					<< tab << "\tconst string k" << n << " = " << key << ";\n"
+					<< tab << "\tstring f" << n << ";\n"
+					<< tab << "\tif ( !k" << n << ".empty() && webapp::FragmentCache::instance().get(k" 
+						<< n << ",f" << n << ") ) {\n"
+					<< tab << "\t\tout->write( f" << n << ".data(), f" << n << ".length(), false );\n"
+					<< tab << "\t} else {\n"
+					<< tab << "\t\twebapp::CaptureSink cap" << n << "( *out, f" << n << " );\n"
+					<< tab << "\t\twebapp::TemplateSink *up" << n << " = out;\n"
+					<< tab << "\t\tif ( !k" << n << ".empty() )\n"
+					<< tab << "\t\t\tout = &cap" << n << ";\n";
+				this->block( output, pc+1, inst.jump, indent+2 );
+				output << tab << "\t\tout = up" << n << ";\n"
+					<< tab << "\t\tif ( !k" << n << ".empty() )\n"
+					<< tab << "\t\t\twebapp::FragmentCache::instance().set( k" << n << ", f" << n 
+						<< ", " << inst.ttl << " );\n"
+					<< tab << "\t}\n"
+					<< tab << "}\n";
+				pc = inst.jump+1;
+				}
+				break;
+
+			default:
+				++pc;
+		}
+	}
+}
+
+/// C++
+/// ɵͷļģݽṹdatarender()html(),
+/// ģΪdataеstringԱ,ѭΪdataеvectorԱ,ѭֶΪнṹstringԱ,
+/// Ϊʽѭ({{#FOR $name}})֧
+/// \param output 
+/// \param name ɴnamespace
+/// \param source ģļ,ڴע
+/// \retval true ɳɹ
+/// \retval false ģֵ֧Ľű,ɵĴ벻
+bool TemplateCodegen::generate( ostream &output, const string &name, const string &source ) {
+	_idents.clear();
+	_used.clear();
+	_vars.clear();
+	_loops.clear();
+	_fields.clear();
+	_stack.clear();
+	_literals.clear();
+	_cursors.clear();
+	_temps = 0;
+	_date = _time = false;
+	_errlog.clear();
+
+	this->ident( "ns", "data" );
+	this->ident( "ns", "render" );
+	this->ident( "ns", "html" );
+	string ns = this->ident( "", name );
+
+	// body first, collect names
+	ostringstream body;
+	this->block( body, 0, _code._code.size(), 1 );
+
+	string guard = "_TMPL2CPP_" + ns + "_H_";
+	for ( size_t i=0; i<guard.length(); ++i )
+		guard[i] = toupper( guard[i] );
+
+	output << "/// \\file " << ns << ".h\n"
+		<< "/// " << ( source!="" ? source+" " : "" ) << "ģɵC++,tmpl2cpp,޸\n\n"
+		<< "#ifndef " << guard << "\n"
+		<< "#define " << guard << "\n\n"
+		<< "#include <ctime>\n"
+		<< "#include <cstdio>\n"
+		<< "#include <string>\n"
+		<< "#include <vector>\n"
+		<< "#include \"waTemplate.h\"\n\n"
+		<< "namespace " << ns << " {\n\n"
+		<< "using namespace std;\n\n";
+
+	// loop rows
+	for ( size_t i=0; i<_loops.size(); ++i ) {
+		string loop = _code._symbols->name( _loops[i] );
+		output << "/// ѭ " << loop << " \n"
+			<< "struct " << this->ident("ns",loop+"_row") << " {\n";
+		const vector<int> &fields = _fields[_loops[i]];
+		for ( size_t f=0; f<fields.size(); ++f )
+			output << "\tstring " << this->field(_loops[i],fields[f]) << ";\n";
+		output << "};\n\n";
+	}
+
+	// data
+	output << "/// ģ\n"
+		<< "struct data {\n";
+	for ( size_t i=0; i<_vars.size(); ++i )
+		output << "\tstring " << this->ident("data",_code._symbols->name(_vars[i])) << ";\n";
+	for ( size_t i=0; i<_loops.size(); ++i ) {
+		string loop = _code._symbols->name( _loops[i] );
+		output << "\tvector<" << this->ident("ns",loop+"_row") << "> " 
+			<< this->loop_ident(_loops[i]) << ";\n";
+	}
+	output << "};\n\n";
+
+	// render
+	output << "/// ģ\n"
+		<< "/// \\param d ģ\n"
+		<< "/// \\param output ģ\n"
+		<< "inline void render( const data &d, webapp::TemplateSink &output ) {\n";
+	for ( size_t i=0; i<_literals.size(); ++i )
+		output << _literals[i];
+	output << "\twebapp::TemplateSink *out = &output;\n";
+	for ( size_t i=0; i<_loops.size(); ++i ) {
+		string id = this->loop_ident( _loops[i] );
+		if ( _cursors.find(id) != _cursors.end() )
+			output << "\tsize_t c_" << id << " = 0;\n";
+	}
+	if ( _date || _time ) {
+		output << "\tchar date_[15], time_[15];\n"
+			<< "\tstruct tm stm;\n"
+			<< "\ttime_t tt = time( 0 );\n"
+			<< "\tlocaltime_r( &tt, &stm );\n"
+			<< "\tsnprintf( date_, 15, \"%d-%d-%d\", stm.tm_year+1900, stm.tm_mon+1, stm.tm_mday );\n"
+			<< "\tsnprintf( time_, 15, \"%d:%d:%d\", stm.tm_hour, stm.tm_min, stm.tm_sec );\n";
+	}
+	output << "\n" << body.str() << "\tout->flush();\n"
+		<< "}\n\n";
+
+	// html
+	output << "/// HTMLַ\n"
+		<< "/// \\param d ģ\n"
+		<< "/// \\return ģ\n"
+		<< "inline string html( const data &d ) {\n"
+		<< "\tstring result;\n"
+		<< "\twebapp::StringSink sink( result );\n"
+		<< "\trender( d, sink );\n"
+		<< "\treturn result;\n"
+		<< "}\n\n"
+		<< "} // namespace\n\n"
+		<< "#endif //" << guard << "\n";
+
+	for ( multimap<int,string>::const_iterator i=_errlog.begin(); i!=_errlog.end(); ++i )
+		output << "#error \"line " << i->first << ": " << i->second << "\"\n";
+	return _errlog.empty();
+}
+
+////////////////////////////////////////////////////////////////////////////
+// template functions
+
+/// ȡHTMLģļ
+/// \param tmpl_file ģ·ļ
+/// \retval true ȡɹ
+/// \retval false ʧ
+bool Template::load( const string &tmpl_file ) {
+	String tmpl;
+	if ( tmpl.load_file(tmpl_file) ) {
+		_tmplfile = tmpl_file;
+		_code = CompiledTemplatePtr( new CompiledTemplate(tmpl,tmpl_dirname(tmpl_file)) );
+		this->bind( *_code );
+		return true;
+	} else {
+		_tmplfile = "Error: Can't open file " + tmpl_file;
+		this->error_log( 0, _tmplfile );
+		return false;
+	}
+}
+
+/// ģ建ȡHTMLģļ
+/// ʹý̹ģ建TemplateCache::instance(),
+/// ģļδ޸ʱȡļҲ±
+/// \param tmpl_file ģ·ļ
+/// \retval true ȡɹ
+/// \retval false ʧ
+bool Template::load_cached( const string &tmpl_file ) {
+	CompiledTemplatePtr code = TemplateCache::instance().get( tmpl_file );
+	if ( code.get() != 0 ) {
+		_tmplfile = tmpl_file;
+		_code = code;
+		this->bind( *_code );
+		return true;
+	} else {
+		_tmplfile = "Error: Can't open file " + tmpl_file;
+		this->error_log( 0, _tmplfile );
+		return false;
+	}
+}
+
+/// HTMLģ
+/// \param tmpl ģַ
+void Template::tmpl( const string &tmpl ) {
+	_tmplfile = "Read from string";
+	_code = CompiledTemplatePtr( new CompiledTemplate(tmpl) );
+	this->bind( *_code );
+}
+
+/// ִģָ
+/// \param output ģ
+void Template::render( TemplateSink &output ) {
+	if ( _code.get() == 0 ) {
+		this->error_log( 0, "Error: Templet not initialized" );
+		return;
+	}
+	_code->render( *this, output, &_errlog );
+}
+
+/// ģ¼
+/// \param output 
+void Template::parse_log( ostream &output ) {
+	struct tm stm;
+	time_t tt = time( 0 );
+	localtime_r( &tt, &stm );
+	char date[15], time[15];
+	snprintf( date, 15, "%d-%d-%d", stm.tm_year+1900, stm.tm_mon+1, stm.tm_mday );
+	snprintf( time, 15, "%d:%d:%d", stm.tm_hour, stm.tm_min, stm.tm_sec );
+
+	output << endl;
+	output << "<!-- Generated by waTemplate " << date << " " << time << endl
+		<< "  Templet source: " << _tmplfile << endl
+		<< "  Loops: " << _loops.size()-count(_loops.begin(),_loops.end(),(tmpl_loop*)0) << endl;
+
+	for ( size_t i=0; i<_loops.size(); ++i ) {
+		if ( _loops[i] != 0 ) {
+			output << "    Loop " << this->name( i ) << "\t\t";
+			if ( _loops[i]->generator != 0 )
+				output << "generated rows" << endl;
+			else
+				output << _loops[i]->rows << " rows" << endl;
+		}
+	}
+
+	// compile errors and render errors
+	multimap<int,string> errlog;
+	if ( _code.get() != 0 )
+		errlog = _code->errors();
+	errlog.insert( _errlog.begin(), _errlog.end() );
+
+	output << "  Errors: " << errlog.size() << endl;
+	for ( multimap<int,string>::const_iterator i=errlog.begin(); i!=errlog.end(); ++i ) {
+		output << "    Line " << i->first+1
+			<< "\t\t" << i->second << endl;
+	}
+			   
+	output << "-->";
+	_errlog.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////
+// output functions
+
+/// HTML
+/// ģıֱӴݸӿ,
+/// \param output ģ,FdSinkʹwritev()дļ
+/// \param mode ǷϢ
+/// - Template::TMPL_OUTPUT_DEBUG Ϣ
+/// - Template::TMPL_OUTPUT_RELEASE Ϣ
+/// - ĬΪϢ
+void Template::output( TemplateSink &output, const output_mode mode ) {
+	_debug = mode;
+	this->render( output );
+	if ( _debug == TMPL_OUTPUT_DEBUG ) {
+		ostringstream log;
+		this->parse_log( log );
+		string str = log.str();
+		output.write( str.data(), str.length(), false );
+		output.flush();
+	}
+}
+
+/// HTMLַ
+/// \return ģ
+string Template::html() {
+	string result;
+	if ( _code.get() != 0 )
+		result.reserve( _code->text().length() );
+	StringSink sink( result );
+	this->render( sink );
+	result += '\0'; // ends in earlier versions
+	return result;
+}
+
+/// HTMLstdout
+/// \param mode ǷϢ
+/// - Template::TMPL_OUTPUT_DEBUG Ϣ
+/// - Template::TMPL_OUTPUT_RELEASE Ϣ
+/// - ĬΪϢ
+void Template::print( const output_mode mode ) {
+	OstreamSink sink( std::cout );
+	this->output( sink, mode );
+}
+
+/// ֶHTMLstdout
+/// ݴﵽָȻ{{#FLUSH}}ʱд,ȴģ,
+/// ͻ˿ǰҳ濪ʼ
+/// \param mode ǷϢ
+/// - Template::TMPL_OUTPUT_DEBUG Ϣ
+/// - Template::TMPL_OUTPUT_RELEASE Ϣ
+/// - ĬΪϢ
+/// \param flush_size ݴﵽóʱд,ĬΪ8192
+/// \param chunked ǷʹHTTPֿ鴫,ĬΪ,
+/// ֱHTTPӦ"Transfer-Encoding: chunked"Ӧͷʱʹ
+void Template::stream( const output_mode mode, const size_t flush_size, const bool chunked ) {
+	// write HTTP header first
+	std::cout.flush();
+	fflush( stdout );
+
+	FdSink sink( STDOUT_FILENO, 16384, flush_size );
+	if ( chunked ) {
+		ChunkedSink chunks( sink, flush_size );
+		this->output( chunks, mode );
+		chunks.finish();
+	} else {
+		this->output( sink, mode );
+	}
 }
 
 /// HTMLļ
@@ -1041,10 +3810,8 @@ bool Template::print( const string &file, const output_mode mode,
 	ofstream outfile( file.c_str(), ios::trunc|ios::out );
 	if ( outfile ) {
 		// parse
-		_debug = mode;
-		this->parse( _tmpl, outfile );
-		if ( _debug == TMPL_OUTPUT_DEBUG ) 
-			this->parse_log( outfile );
+		OstreamSink sink( outfile );
+		this->output( sink, mode );
 		outfile.close();
 		
 		// chmod
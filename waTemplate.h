@@ -1,7 +1,7 @@
 /// \file waTemplate.h
 /// HTMLģ崦ͷļ
 /// ֧ѭűHTMLģ崦
-///  waString
+///  waString, waJson
 /// <a href="wa_template.html">ʹ˵ĵ򵥷</a>
 
 #ifndef _WEBAPPLIB_TMPL_H_
@@ -11,16 +11,1302 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <list>
+#include <pthread.h>
+#include <sys/uio.h>
 #include "waString.h"
 
 using namespace std;
 
 /// Web Application Library namaspace
 namespace webapp {
+
+class Json;
+#ifndef _WEBAPPLIB_NOMYSQL
+class MysqlData;
+#endif
+	
+/// ģָ
+/// ģָ,ģ˳򱣴CompiledTemplate::code()
+typedef struct {
+	int type;				// ű,μtmpl_scripttype
+	size_t pos;				// ģıʼλ
+	size_t len;				// ģı
+	string exp;				// űʽ
+	size_t jump;			// #IF,#ELSIF,#ELSE:һ֧λ,#FOR:#ENDFORλ,#ENDFOR:#FORλ(δպʱΪλ)
+	size_t end;				// #IF,#ELSIF,#ELSE:#ENDIFλ
+	int line;				// ģ
+	int val;				// 滻,#FOR:ʽбλ,Ϊ-1
+	int cond;				// #IF,#ELSIF:ʽбλ,Ϊ-1
+	int ttl;				// #CACHE:Чʱ,λΪ,0Ϊ
+} tmpl_inst;
+
+/// ģļ
+/// ʱ{{#INCLUDE}}ȡļ,CompiledTemplate::depends()
+typedef struct {
+	string file;			// ļ·
+	time_t mtime;			// ʱļ޸ʱ
+	off_t size;				// ʱļС
+} tmpl_depend;
+
+/// ģƷű
+/// ģеıѭֶڱʱתΪ,ÿCompiledTemplateӵԼķű,
+/// ֻ,ڶ߳ʹ,CompiledTemplate󶨸ģRenderContext,
+/// üΪ0ʱɾ
+class TemplateSymbol {
+	public:
+
+	/// ĬϹ캯,üΪ1
+	TemplateSymbol():
+	_refs(1)
+	{};
+
+	/// Ʊ,Ʋʱ
+	int id( const string &name );
+	/// Ʊ
+	int find( const string &name ) const;
+	/// رŶӦ
+	const string& name( const int id ) const;
+	/// ط
+	/// \return 
+	inline int size() const {
+		return _names.size();
+	}
+
+	/// ü
+	/// \return ű
+	inline const TemplateSymbol* retain() const {
+		__sync_add_and_fetch( &_refs, 1 );
+		return this;
+	}
+	/// ü,Ϊ0ʱɾ
+	inline void release() const {
+		if ( __sync_sub_and_fetch(&_refs,1) == 0 )
+			delete this;
+	}
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// ,ֻͨrelease()ɾ
+	~TemplateSymbol(){};
+	/// ֹÿ캯
+	TemplateSymbol( TemplateSymbol &copy );
+	/// ֹÿֵ
+	TemplateSymbol& operator = ( const TemplateSymbol& copy );
+
+	map<string,int> _ids;			// Ʊб <,>
+	vector<string> _names;			// б,
+	mutable int _refs;				// ü
+};
+
+class CompiledTemplate;
+
+/// ģѭԴӿ
+/// ѭݱģ֮ʱʵָýӿ,ͨRenderContext::bind_loop()󶨵ѭ,
+/// ʱֱӶȡԴе,Ƶģѭ,
+/// ߳ͬʱʱԱܱͬʱ
+class TemplateRows {
+	public:
+
+	/// 
+	virtual ~TemplateRows(){};
+
+	/// ֶ
+	virtual size_t cols() const = 0;
+	/// ֶ
+	/// \param col ֶλ
+	/// \return ֶ
+	virtual string field( const size_t col ) const = 0;
+	/// 
+	virtual size_t rows() const = 0;
+	/// 
+	/// \param row λ
+	/// \param col ֶλ
+	/// \param len ݳ
+	/// \return ݿʼλ,Ҫ'\0'β
+	virtual const char* cell( const size_t row, const size_t col, size_t &len ) const = 0;
+
+	/// Դ
+	/// RenderContext为ɾԴʱ
+	/// \return ʹnewԴ,ĬϷ0,ԭRenderContextͬһԴ
+	virtual TemplateRows* clone() const {
+		return 0;
+	}
+};
+
+/// ѭδ֪
+const size_t TMPL_ROWS_UNKNOWN = static_cast<size_t>( -1 );
+
+/// ģѭӿ
+/// ѭʱжȡ,вҪԤȫɲڴ,
+/// ,ͬһͬʱڶ̵߳
+class TemplateGenerator : public TemplateRows {
+	public:
+
+	/// 
+	virtual ~TemplateGenerator(){};
+
+	/// ȡһ
+	/// ÿνѭʱӵ0пʼ˳,truecell()ֻȡ
+	/// \param row λ
+	/// \retval true ȡɹ
+	/// \retval false ûи,ѭ
+	virtual bool fetch( const size_t row ) = 0;
+
+	/// 
+	/// ģʹ%ROWSʱ,ڵʱټ,
+	/// ĬϷTMPL_ROWS_UNKNOWN,ʱ%ROWSΪַ
+	/// \return 
+	virtual size_t rows() const {
+		return TMPL_ROWS_UNKNOWN;
+	}
+};
+
+#ifndef _WEBAPPLIB_NOMYSQL
+/// MysqlDataѭԴ
+/// ȡMysqlDataݼMYSQL_ROWָ,,
+/// ʹڼMysqlData뱣ЧҲٴڲѯ
+class MysqlRows : public TemplateRows {
+	public:
+
+	/// 캯
+	MysqlRows( MysqlData &data );
+
+	/// 
+	virtual ~MysqlRows(){};
+
+	/// ֶ
+	/// \return ֶ
+	virtual size_t cols() const {
+		return _fields.size();
+	}
+	/// ֶ
+	/// \param col ֶλ
+	/// \return ֶ
+	virtual string field( const size_t col ) const {
+		return _fields[col];
+	}
+	/// 
+	/// \return 
+	virtual size_t rows() const {
+		return _rows.size();
+	}
+	/// 
+	virtual const char* cell( const size_t row, const size_t col, size_t &len ) const;
+
+	/// Դ
+	/// \return Դ
+	virtual TemplateRows* clone() const {
+		return new MysqlRows( *this );
+	}
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	vector<string> _fields;				// ֶб
+	vector<char**> _rows;				// б,MYSQL_ROW
+	vector<unsigned long> _lengths;		// ݳб,˳򱣴
+};
+#endif
+
+/// ģ
+/// 滻ѭ,ģCompiledTemplate,
+/// ʱֻȡ޸,ͬһRenderContextͬʱڶ߳,
+/// ָϲ,δõ滻ѭδϲжȡ,
+/// ȫ֡վ㡢,ϲݲ,ʹڼ뱣Ч,
+/// ģģķű,ģûеֻڱ
+class RenderContext {
+	public:
+
+	/// ĬϹ캯
+	RenderContext():
+	_symbols(0), _parent(0), _parallel(0)
+	{};
+
+	/// 캯
+	/// \param parent ϲ,ʹڼ뱣Ч
+	explicit RenderContext( const RenderContext *parent ):
+	_symbols(0), _parent(parent), _parallel(0)
+	{};
+
+	/// 캯
+	RenderContext( const RenderContext &copy ):
+	_symbols(0), _parent(0), _parallel(0)
+	{
+		*this = copy;
+	}
+
+	/// 
+	virtual ~RenderContext() {
+		this->clear_set();
+		if ( _symbols != 0 )
+			_symbols->release();
+	}
+
+	/// ֵ
+	RenderContext& operator = ( const RenderContext &copy );
+
+	/// 滻
+	void set( const string &name, const string &value );
+	/// 滻
+	/// \param name ģ
+	/// \param value 滻ֵ
+	inline void set( const string &name, const char *value ) {
+		this->set( name, string(value) );
+	}
+	/// 滻
+	void set( const string &name, const long value );
+	/// 滻
+	/// \param name ģ
+	/// \param value 滻ֵ
+	inline void set( const string &name, const int value ) {
+		this->set( name, static_cast<long>(value) );
+	}
+	/// 滻
+	/// \param name ģ
+	/// \param value 滻ֵ
+	inline void set( const string &name, const unsigned int value ) {
+		this->set( name, static_cast<long>(value) );
+	}
+	/// 滻
+	/// \param name ģ
+	/// \param value 滻ֵ
+	inline void set( const string &name, const unsigned long value ) {
+		this->set( name, static_cast<long>(value) );
+	}
+	/// ø滻
+	void set( const string &name, const double value, const int ndigit = 2 );
+	/// òֵ滻
+	void set( const string &name, const bool value );
+	
+	/// ½ѭ
+	void def_loop( const string &loop, const char* field_0, ... );
+	/// һݵѭ
+	void append_row( const string &loop, const char* value_0, ... );
+	/// һָʽݵѭ
+	void append_format( const string &loop, const char* format, ... );
+	/// һݵѭ
+	void append_row( const string &loop, const vector<string> &values );
+	/// Ӷݵѭ
+	void append_rows( const string &loop, const vector< vector<string> > &rows );
+	/// Ӷݵѭ
+	void append_rows( const string &loop, const char* const *values, const size_t rows,
+		const size_t *lengths = 0 );
+	/// Ԥѭݿռ
+	void reserve_rows( const string &loop, const size_t rows, const size_t bytes = 0 );
+
+	/// ѭԴ
+	void bind_loop( const string &loop, const TemplateRows &rows );
+	/// ѭ
+	void bind_loop( const string &loop, TemplateGenerator &generator );
+	#ifndef _WEBAPPLIB_NOMYSQL
+	/// MysqlDataݼѭ
+	void bind_loop( const string &loop, MysqlData &data );
+	#endif
 	
+	/// 滻
+	void clear_set();
+
+	/// ģ
+	void bind( const CompiledTemplate &tmpl );
+
+	/// ϲ
+	void set_parent( const RenderContext *parent );
+	/// ϲ
+	/// \return ϲ,Ϊ0
+	inline const RenderContext* parent() const {
+		return _parent;
+	}
+
+	/// òѭ
+	/// н϶ѭֶTemplatePool::instance()е߳ͬʱ,
+	/// ҪȵTemplatePool::set_threads()߳
+	/// \param min_rows ÿ,Ϊ0ʱ
+	inline void set_parallel( const int min_rows ) {
+		_parallel = min_rows;
+	}
+	/// زѭÿ
+	/// \return ÿ,Ϊ0
+	inline int parallel() const {
+		return _parallel;
+	}
+
+	/// ѭΪJSON
+	void json( const string &loop, Json &json ) const;
+
+	////////////////////////////////////////////////////////////////////////////
+	protected:
+
+	/// ô¼
+	void error_log( const size_t lines, const string &error );
+
+	// ݶ
+	typedef vector<string> strings;		// ַб
+	typedef struct {					// 滻ֵṹ
+		int type;						// ֵ,μtmpl_vartype
+		long num;						// ֵ,ֵΪ01
+		double real;					// ֵ
+		int ndigit;						// ʱСλ
+	} tmpl_var;
+	typedef struct {					// ѭݵԪṹ
+		size_t pos;						// ѭݻеλ
+		size_t len;						// ݳ
+	} tmpl_cell;
+	typedef struct {					// ѭģýṹ
+		int cols;						// ѭֶ
+		int rows;						// ѭ
+		strings fields;					// ѭֶζб
+		vector<int> fieldspos;			// ѭֶλ,ݵƱ,δΪ-1
+		string arena;					// ѭݻ,
+		vector< vector<tmpl_cell> > columns;	// ѭ,бݵԪλ
+		const TemplateRows *source;		// ѭԴ,δΪ0
+		TemplateRows *owned;			// RenderContextɾѭԴ,Ϊ0
+		TemplateGenerator *generator;	// ѭ,Ϊ0
+	} tmpl_loop;
+
+	/// Ʊ
+	int find( const string &name ) const;
+	/// Ʊ,Ʋʱ
+	size_t slot( const string &name );
+	/// رŶӦ
+	string name( const size_t slot ) const;
+	/// ģű
+	void bind( const TemplateSymbol *symbols );
+	/// ѭֶλ
+	void index_fields( tmpl_loop &data );
+
+	/// 滻ֵλ
+	size_t var( const string &name );
+	/// ʽ滻ֵ
+	static void format( const tmpl_var &var, string &buf );
+
+	/// ؿݵѭ
+	tmpl_loop* append_loop( const string &loop, const char *func );
+	/// ѭԴ
+	void bind_loop( const string &loop, const TemplateRows *rows, TemplateRows *owned,
+		TemplateGenerator *generator = 0 );
+
+	/// ݵԪ
+	/// \param data ѭ
+	/// \param col ֶλ
+	/// \param val 
+	/// \param len ݳ
+	inline void append_cell( tmpl_loop &data, const int col, const char *val, const size_t len ) {
+		if ( col < data.cols ) {
+			tmpl_cell cell = { data.arena.length(), len };
+			data.arena.append( val, len );
+			data.columns[col].push_back( cell );
+		}
+	}
+	/// һ,ֶַ
+	/// \param data ѭ
+	/// \param cols ӵֶ
+	inline void append_end( tmpl_loop &data, const int cols ) {
+		for ( int i=cols; i<data.cols; ++i )
+			this->append_cell( data, i, "", 0 );
+		++data.rows;
+	}
+	/// ݵԪ
+	/// \param data ѭ
+	/// \param col ֶλ
+	/// \param row λ
+	/// \param len ݳ
+	/// \return ݿʼλ
+	static inline const char* cell( const tmpl_loop &data, const int col, const int row,
+		size_t &len )
+	{
+		if ( data.source != 0 )
+			return data.source->cell( row, col, len );
+		const tmpl_cell &cell = data.columns[col][row];
+		len = cell.len;
+		return data.arena.data()+cell.pos;
+	}
+
+	/// ѭ
+	tmpl_loop* loop( const string &loop );
+
+	/// رѭ
+	/// \param slot ѭƱ
+	/// \return ѭ,ѭδ巵0
+	inline tmpl_loop* loop( const int slot ) const {
+		if ( slot>=0 && static_cast<size_t>(slot)<_loops.size() )
+			return _loops[slot];
+		return 0;
+	}
+
+	const TemplateSymbol *_symbols;		// 󶨵ģű,δΪ0
+	map<string,int> _others;			// űûеƱ <,>,Ŵӷʼ
+	strings _sets;						// 滻б,Ʊ
+	vector<tmpl_var> _vars;				// 滻ֵб,Ʊ,ֵַʱŸʽ
+	vector<bool> _isset;				// ģǷ,Ʊ
+	vector<tmpl_loop*> _loops;			// ѭ滻б,Ʊ,δΪ0
+	multimap<int,string> _errlog;		// ¼ <λ,Ϣ>
+	const RenderContext *_parent;		// ϲ,Ϊ0
+	int _parallel;						// ѭÿ,Ϊ0
+
+	friend class CompiledTemplate;
+};
+
+/// ģӿ
+/// ģ尴˳Ϊ,ÿΪݿʼλü,
+/// ģıݲ,ֱӴݸӿ
+class TemplateSink {
+	public:
+
+	/// 
+	virtual ~TemplateSink(){};
+
+	/// 
+	/// \param data ݿʼλ
+	/// \param len ݳ
+	/// \param stable ΪtrueʱڱģǰЧ,
+	/// ΪfalseʱֻڱεڼЧ,Ҫʱ븴
+	virtual void write( const char *data, const size_t len, const bool stable ) = 0;
+
+	/// 
+	/// ģ{{#FLUSH}}ʱ
+	virtual void flush(){};
+};
+
+/// ַģ
+/// ׷ӵַ
+class StringSink : public TemplateSink {
+	public:
+
+	/// 캯
+	/// \param output ַ
+	StringSink( string &output ):
+	_output(output)
+	{};
+
+	/// 
+	/// \param data ݿʼλ
+	/// \param len ݳ
+	virtual void write( const char *data, const size_t len, const bool ) {
+		_output.append( data, len );
+	}
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	string &_output;
+};
+
+/// ģ
+/// д
+class OstreamSink : public TemplateSink {
+	public:
+
+	/// 캯
+	/// \param output 
+	/// \param flush_size ݴﵽóʱˢ,ĬΪ0ֻʱˢ
+	OstreamSink( ostream &output, const size_t flush_size = 0 ):
+	_output(output), _flush_size(flush_size), _pending(0)
+	{};
+
+	/// 
+	/// \param data ݿʼλ
+	/// \param len ݳ
+	virtual void write( const char *data, const size_t len, const bool ) {
+		_output.write( data, len );
+		_pending += len;
+		if ( _flush_size>0 && _pending>=_flush_size )
+			this->flush();
+	}
+
+	/// ˢ
+	virtual void flush() {
+		_output.flush();
+		_pending = 0;
+	}
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	ostream &_output;
+	size_t _flush_size;		// flush threshold, 0 if none
+	size_t _pending;		// bytes since last flush
+};
+
+/// Ƭλģ
+/// д¼ӿ,ͬʱ׷ӵַ
+class CaptureSink : public TemplateSink {
+	public:
+
+	/// 캯
+	/// \param output ¼ӿ
+	/// \param data ׷ݵַ
+	CaptureSink( TemplateSink &output, string &data ):
+	_output(output), _data(data)
+	{};
+
+	/// 
+	/// \param data ݿʼλ
+	/// \param len ݳ
+	/// \param stable ڱģǰǷ񱣳Ч
+	virtual void write( const char *data, const size_t len, const bool stable ) {
+		_output.write( data, len, stable );
+		_data.append( data, len );
+	}
+
+	/// ˢ¼ӿ
+	virtual void flush() {
+		_output.flush();
+	}
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	TemplateSink &_output;
+	string &_data;
+};
+
+/// ļģ
+/// ռݵλü,ʹwritev()һд,
+/// ģıǰЧݲ,ݸƵڲ
+class FdSink : public TemplateSink {
+	public:
+
+	/// 캯
+	FdSink( const int fd, const size_t buffer = 16384, const size_t flush_size = 0 );
+
+	/// 
+	virtual ~FdSink();
+
+	/// 
+	virtual void write( const char *data, const size_t len, const bool stable );
+	/// дļ
+	virtual void flush();
+
+	/// Ƿдʧ
+	/// \retval true дʧ,֮ݲд
+	/// \retval false ûʧ
+	inline bool failed() const {
+		return _failed;
+	}
+	/// дֽ
+	/// \return дֽ
+	inline size_t bytes() const {
+		return _bytes;
+	}
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// ݶ
+	void append( const char *data, const size_t len );
+
+	/// ֹÿ캯
+	FdSink( FdSink &copy );
+	/// ֹÿֵ
+	FdSink& operator = ( const FdSink& copy );
+
+	int _fd;						// ļ
+	vector<struct iovec> _iov;		// дݶб
+	char *_buf;						// ݻ
+	size_t _size;					// ݻС
+	size_t _used;					// ݻʹôС
+	size_t _flush_size;				// дֵ,0Ϊ
+	size_t _pending;				// дֽ
+	size_t _bytes;					// дֽ
+	bool _failed;					// Ƿдʧ
+};
+
+/// HTTPֿ鴫ģ
+/// ݴﵽָȡ{{#FLUSH}}ģʱ,
+/// Ϊһchunkд¼ӿ,ֱHTTPӦķ,
+/// ӦͷҪ"Transfer-Encoding: chunked",ɺfinish()
+class ChunkedSink : public TemplateSink {
+	public:
+
+	/// 캯
+	/// \param output ¼ӿ,FdSink
+	/// \param chunk_size chunkֵ,ĬΪ8192
+	ChunkedSink( TemplateSink &output, const size_t chunk_size = 8192 ):
+	_output(output), _chunk_size(chunk_size), _pending(0), _finished(false)
+	{};
+
+	/// 
+	/// δfinish()ʱԶ
+	virtual ~ChunkedSink() {
+		this->finish();
+	}
+
+	/// 
+	virtual void write( const char *data, const size_t len, const bool stable );
+	/// chunkˢ¼ӿ
+	virtual void flush();
+	/// chunk,ֿ鴫
+	void finish();
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// chunk
+	void chunk();
+
+	/// ֹÿ캯
+	ChunkedSink( ChunkedSink &copy );
+	/// ֹÿֵ
+	ChunkedSink& operator = ( const ChunkedSink& copy );
+
+	/// ݶ
+	typedef struct {
+		const char *data;	// ݿʼλ,ƵΪ0
+		size_t pos;			// еλ
+		size_t len;			// ݳ
+	} chunk_seg;
+
+	TemplateSink &_output;			// ¼ӿ
+	vector<chunk_seg> _segs;		// ǰchunkݶб
+	string _buf;					// ܱЧݻ
+	size_t _chunk_size;				// chunkֵ
+	size_t _pending;				// ǰchunk
+	bool _finished;					// Ƿѽ
+};
+
+/// HTMLģ
+/// ģֻһ,ɴתλõָ,ʱ˳ִָ,
+/// ģıʱٱ,
+/// ޸,ݱڵջ,ͬʱڶ߳
+class CompiledTemplate {
+	public:
+
+	/// ĬϹ캯
+	CompiledTemplate():
+	_symbols(new TemplateSymbol), _refs(0)
+	{};
+
+	/// 캯
+	/// \param tmpl ģ
+	/// \param tmpl_dir {{#INCLUDE}}ļ·Ŀ¼,ĬΪǰĿ¼
+	/// \param consts 滻,ĬΪ0۵
+	CompiledTemplate( const string &tmpl, const string &tmpl_dir = "",
+		const RenderContext *consts = 0 ):
+	_symbols(new TemplateSymbol), _refs(0)
+	{
+		this->compile( tmpl, tmpl_dir, consts );
+	}
+
+	/// 
+	virtual ~CompiledTemplate() {
+		_symbols->release();
+	}
+
+	/// ģ
+	void compile( const string &tmpl, const string &tmpl_dir = "",
+		const RenderContext *consts = 0 );
+	/// ѹģı
+	void minify();
+
+	/// ģǷΪ
+	/// \retval true ģΪ
+	/// \retval false ģ岻Ϊ
+	inline bool empty() const {
+		return _text.empty();
+	}
+	/// ģ
+	/// \return ģ,۵ѹΪģ
+	inline const string& text() const {
+		return _text;
+	}
+	/// ģָ
+	/// \return ģָ
+	inline const vector<tmpl_inst>& code() const {
+		return _code;
+	}
+	/// ر¼
+	/// \return ¼ <λ,Ϣ>
+	inline const multimap<int,string>& errors() const {
+		return _errlog;
+	}
+	/// ļб
+	/// \return {{#INCLUDE}}ȡļб
+	inline const vector<tmpl_depend>& depends() const {
+		return _depends;
+	}
+	/// ļǷ޸
+	bool modified() const;
+
+	/// ģ
+	void render( const RenderContext &ctx, TemplateSink &output,
+		multimap<int,string> *errlog = 0 ) const;
+	/// ģ嵽
+	void render( const RenderContext &ctx, ostream &output,
+		multimap<int,string> *errlog = 0 ) const;
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	typedef struct {					// ʽṹ
+		int type;						// ʽ,μtmpl_scripttype,ַΪTMPL_S_TEXT
+		int slot;						// ֶƱ,ַΪѭƱ
+		int scope;						// ѭΧʽλ,Ϊ-1
+		string text;					// ַ
+		bool isnum;						// ַǷΪ
+		long num;						// ֵַ
+	} tmpl_value;
+	typedef struct {					// Ƚϱʽṹ
+		int op;							// Ƚ,μtmpl_cmptype
+		int lhs;						// ʽλ
+		int rhs;						// Ҳʽλ,ޱȽΪ-1
+	} tmpl_cmp;
+	typedef struct {					// ʽṹ
+		int logic;						// ߼,μtmpl_logictype
+		vector<tmpl_cmp> items;			// Ƚϱʽб
+	} tmpl_cond;
+	typedef struct {					// Ƚṹ
+		const char *str;				// ֵʼλ,ַ滻ֵδʽʱΪ0
+		size_t len;						// ֵ
+		const RenderContext::tmpl_var *var;	// ַ滻ֵ,Ϊ0
+		bool isnum;						// ֵǷΪ
+		bool isreal;					// ֵǷΪ
+		long num;						// ֵ
+		double real;					// ֵ
+	} tmpl_operand;
+
+	typedef struct {					// Ƭλ¼ṹ
+		size_t end;						// #ENDCACHEλ
+		string key;						// 
+		int ttl;						// Чʱ
+		string data;					// Ƭ
+	} tmpl_capture;
+
+	typedef struct {					// ѭǶ׼¼ṹ
+		int loop;						// ϲѭƱ
+		int cursor;						// ϲѭλ
+	} tmpl_frame;
+	typedef struct {					// ݲṹ
+		const RenderContext *ctx;		// ݻϲ
+		bool bound;						// Ƿ󶨱ģ,ʱƱͬ
+		vector<int> slots;				// δʱƱŶӦƱ,Ϊ-1
+	} tmpl_scope;
+	typedef struct {					// ݽṹ
+		const RenderContext *ctx;		// 
+		vector<tmpl_scope> scopes;		// ݼϲ
+		vector<string> names;			// ʱѭ,Ŵӷʼ
+		int loop;						// ǰѭƱ,Ϊ-1
+		int cursor;						// ǰѭλ
+		const RenderContext::tmpl_loop *data;	// ǰѭ,δΪ0
+		int owner;						// ǰѭڵݲ
+		vector<int> cursors;			// ѭλ,ѭƱ
+		vector<int> fetched;			// ѭѶȡλ,ѭƱ
+		vector<tmpl_frame> frames;		// ѭǶ׼¼
+		int lines;						// Ѵģ
+		char date[15];					// ǰ
+		char time[15];					// ǰʱ
+		string buf;						// ʽֵ
+		string lhs;						// Ƚϱʽֵ
+		bool stable;					// ʽֵǰǷ񱣳Ч
+		vector<tmpl_capture> captures;	// Ƭλ
+		list<string> fragments;			// еƬλ,ǰЧ
+		multimap<int,string> *errlog;	// ¼,¼Ϊ0
+	} tmpl_state;
+	typedef struct {					// ѭνṹ
+		const CompiledTemplate *tmpl;	// ģ
+		size_t pc;						// #FORָλ
+		int begin;						// ʼλ
+		int end;						// λ,
+		tmpl_state st;					// 
+		string output;					// 
+		multimap<int,string> errlog;	// ¼
+	} tmpl_slice;
+
+	/// ʽ
+	int compile_value( const string &exp );
+	/// ѭƱʽ
+	int compile_scope( const string &exp );
+	/// ʽ
+	int compile_cond( const string &exp, const int line );
+	/// Ƚϱʽ
+	tmpl_cmp compile_cmp( const string &exp );
+
+	/// 
+	/// ͬʱ׷ӵƬλ
+	/// \param st 
+	/// \param output ģ
+	/// \param data ݿʼλ
+	/// \param len ݳ
+	/// \param stable ǰǷ񱣳Ч
+	inline void write( tmpl_state &st, TemplateSink &output, const char *data,
+		const size_t len, const bool stable ) const
+	{
+		output.write( data, len, stable );
+		for ( size_t i=0; i<st.captures.size(); ++i )
+			st.captures[i].data.append( data, len );
+	}
+
+	/// ִģָ
+	void execute( tmpl_state &st, TemplateSink &output, size_t pc, const size_t end ) const;
+	/// ѭ
+	bool parallel( tmpl_state &st, TemplateSink &output, const size_t pc, const int loop,
+		const RenderContext::tmpl_loop *data, const int owner ) const;
+	/// ѭһ
+	static void render_slice( void *arg );
+	/// Ƿȡѭ
+	bool generated( const tmpl_state &st, const int scope ) const;
+
+	/// ʼݲ
+	void init_scopes( tmpl_state &st, const RenderContext &ctx ) const;
+	/// ݲеƱ
+	/// \param st 
+	/// \param level ݲ
+	/// \param slot Ʊ
+	/// \return ݲеƱ,ڷ-1
+	inline int resolve( const tmpl_state &st, const size_t level, const int slot ) const {
+		const tmpl_scope &scope = st.scopes[level];
+		if ( slot < _symbols->size() )
+			return scope.bound ? slot : scope.slots[slot];
+		return scope.ctx->find( st.names[slot-_symbols->size()] );
+	}
+	/// 滻ֵ
+	/// δʱδϲв
+	/// \param st 
+	/// \param slot ģƱ
+	/// \param pos 滻ֵڸеλ
+	/// \return ˸滻ֵ,δ÷0
+	inline const RenderContext* lookup( const tmpl_state &st, const int slot, int &pos ) const {
+		for ( size_t i=0; i<st.scopes.size(); ++i ) {
+			const RenderContext *ctx = st.scopes[i].ctx;
+			pos = this->resolve( st, i, slot );
+			if ( pos>=0 && static_cast<size_t>(pos)<ctx->_isset.size() && ctx->_isset[pos] )
+				return ctx;
+		}
+		return 0;
+	}
+	/// ѭ
+	/// δʱδϲжȡ
+	/// \param st 
+	/// \param slot ѭƱ
+	/// \param owner ѭڵݲ
+	/// \return ѭ,ѭδ巵0
+	inline const RenderContext::tmpl_loop* loop( const tmpl_state &st, const int slot,
+		int &owner ) const
+	{
+		if ( slot < 0 )
+			return 0;
+		for ( size_t i=0; i<st.scopes.size(); ++i ) {
+			const RenderContext::tmpl_loop *data = st.scopes[i].ctx->loop( this->resolve(st,i,slot) );
+			if ( data != 0 ) {
+				owner = i;
+				return data;
+			}
+		}
+		return 0;
+	}
+	/// ѭֶλ
+	/// \param st 
+	/// \param data ѭ
+	/// \param owner ѭڵݲ
+	/// \param slot ֶƱ
+	/// \return ֶλ,δ巵-1
+	inline int column( const tmpl_state &st, const RenderContext::tmpl_loop *data,
+		const int owner, const int slot ) const
+	{
+		int pos = this->resolve( st, owner, slot );
+		if ( pos>=0 && static_cast<size_t>(pos)<data->fieldspos.size() )
+			return data->fieldspos[pos];
+		return -1;
+	}
+
+	/// رʽֵ
+	const char* value( tmpl_state &st, const int val, size_t &len ) const;
+	/// ѭƱ
+	int scope( tmpl_state &st, const int val ) const;
+	/// ѭλ
+	int cursor( const tmpl_state &st, const int slot ) const;
+	/// ȡѭ
+	bool fetch( tmpl_state &st, const int slot, const RenderContext::tmpl_loop *data,
+		const int row ) const;
+	/// ѭǷԶȡ
+	bool readable( const tmpl_state &st, const int slot, const RenderContext::tmpl_loop *data,
+		const int row ) const;
+	/// ֧еһķ֧λ
+	size_t branch( tmpl_state &st, size_t pc ) const;
+	/// ȡȽ
+	void operand( tmpl_state &st, const int val, tmpl_operand &arg ) const;
+	/// ȽϱʽǷ
+	bool compare( tmpl_state &st, const tmpl_cmp &cmp ) const;
+	/// Ƿ
+	bool check_if( tmpl_state &st, const int cond ) const;
+	/// ¼
+	void render_log( tmpl_state &st, const string &error ) const;
+
+	/// ȡָλõģűͼʽ
+	int parse_script( const string &tmpl, const size_t pos,
+		string &exp, int &type );
+	/// ָ
+	size_t append( const int type, const size_t pos, const size_t len,
+		const string &exp, const int line );
+	/// ¼
+	void error_log( const int line, const string &error );
+	/// ۵
+	void fold( const RenderContext &consts );
+	/// ʽǷΪ
+	bool constant( const tmpl_state &st, const int val ) const;
+	/// 㳣
+	int constant_if( tmpl_state &st, const int cond ) const;
+
+	/// ֹÿ캯
+	CompiledTemplate( CompiledTemplate &copy );
+	/// ֹÿֵ
+	CompiledTemplate& operator = ( const CompiledTemplate& copy );
+
+	string _text;					// ģ
+	vector<tmpl_inst> _code;		// ģָ
+	vector<tmpl_value> _values;		// ʽб
+	vector<tmpl_cond> _conds;		// ʽб
+	vector<tmpl_depend> _depends;	// ļб
+	multimap<int,string> _errlog;	// ¼ <λ,Ϣ>
+	TemplateSymbol *_symbols;		// Ʒű
+
+	friend class CompiledTemplatePtr;
+	friend class TemplateCodegen;
+	friend class RenderContext;
+	mutable int _refs;				// ü
+};
+
+/// CompiledTemplateָ
+/// üΪԭӲ,ڶ֮߳临ƺͷ,
+/// üΪ0ʱɾָCompiledTemplate
+class CompiledTemplatePtr {
+	public:
+
+	/// ĬϹ캯,ָ
+	CompiledTemplatePtr():
+	_ptr(0)
+	{};
+
+	/// 캯
+	/// \param ptr ʹnewCompiledTemplate,CompiledTemplatePtrɾ
+	explicit CompiledTemplatePtr( const CompiledTemplate *ptr ):
+	_ptr(ptr)
+	{
+		this->retain();
+	}
+
+	/// 캯
+	CompiledTemplatePtr( const CompiledTemplatePtr &copy ):
+	_ptr(copy._ptr)
+	{
+		this->retain();
+	}
+
+	/// 
+	virtual ~CompiledTemplatePtr() {
+		this->release();
+	}
+
+	/// ֵ
+	CompiledTemplatePtr& operator = ( const CompiledTemplatePtr &copy ) {
+		if ( _ptr != copy._ptr ) {
+			copy.retain();
+			this->release();
+			_ptr = copy._ptr;
+		}
+		return *this;
+	}
+
+	/// ָCompiledTemplate
+	inline const CompiledTemplate* get() const {
+		return _ptr;
+	}
+	/// ָCompiledTemplate
+	inline const CompiledTemplate* operator-> () const {
+		return _ptr;
+	}
+	/// ָCompiledTemplate
+	inline const CompiledTemplate& operator* () const {
+		return *_ptr;
+	}
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// ü
+	inline void retain() const {
+		if ( _ptr != 0 )
+			__sync_add_and_fetch( &_ptr->_refs, 1 );
+	}
+	/// ü
+	inline void release() const {
+		if ( _ptr!=0 && __sync_sub_and_fetch(&_ptr->_refs,1)==0 )
+			delete _ptr;
+	}
+
+	const CompiledTemplate *_ptr;
+};
+
+/// ģ建
+/// ģļ·ģ,ڶ֮߳乲,
+/// ÿָʱһģļ޸ʱ,ʹinotifyģļ޸,
+/// ģļ޸ĺ±벢滻,ʹþģTemplateӰ,
+/// ó滻ʱ۵,ѹ޸ĺģ±
+class TemplateCache {
+	public:
+
+	/// ؽ̹ģ建
+	static TemplateCache& instance();
+
+	/// 캯
+	TemplateCache( const int interval = 1 );
+
+	/// 
+	virtual ~TemplateCache();
+
+	/// رģ
+	CompiledTemplatePtr get( const string &tmpl_file );
+
+	/// üģļ޸ʱļ
+	void set_interval( const int interval );
+	/// ʹinotifyģļ޸
+	bool set_inotify( const bool enable );
+
+	/// ó滻
+	void set_consts( const RenderContext &consts );
+	/// 滻
+	void clear_consts();
+	/// س汾
+	unsigned int generation();
+	/// Ƿѹģı
+	void set_minify( const bool enable );
+
+	/// ɾָģ建
+	void remove( const string &tmpl_file );
+	/// ģ建
+	void clear();
+	/// ػģ
+	size_t size();
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// ȡinotify¼
+	void check_inotify();
+	/// inotifyĿ¼
+	int add_watch( const string &tmpl_file );
+
+	/// ֹÿ캯
+	TemplateCache( TemplateCache &copy );
+	/// ֹÿֵ
+	TemplateCache& operator = ( const TemplateCache& copy );
+
+	typedef struct {					// ģ建ṹ
+		CompiledTemplatePtr code;		// ģ
+		time_t mtime;					// ģļ޸ʱ
+		off_t size;						// ģļС
+		time_t checked;					// ϴμʱ
+		bool dirty;						// ģļ޸
+		bool watched;					// Ƿȫinotify,򰴼޸ʱ
+		unsigned int generation;		// ʱĳ汾
+		vector< pair<int,string> > watches;	// inotifyļ(Ŀ¼),ļ
+	} cache_entry;
+
+	map<string,cache_entry> _entries;	// ģ建б <ģļ·,ģ建ṹ>
+	pthread_rwlock_t _lock;				// д
+	int _interval;						// ,λΪ
+	int _inotify;						// inotify,δʹΪ-1
+	unsigned int _inotify_serial;		// inotifyûͣô,֮ǰļʧЧ
+	map<int,string> _watches;			// inotifyĿ¼ <,Ŀ¼>
+	RenderContext _consts;				// 滻
+	bool _fold;							// Ƿ۵
+	bool _minify;						// Ƿѹģı
+	unsigned int _generation;			// 汾,ÿóʱ
+};
+
+/// ģƬλ
+/// {{#CACHE key ttl}}...{{#ENDCACHE}}֮,ƹ,
+/// ʱɾδʹõƬ,ͬʱڶ߳ʹ
+class FragmentCache {
+	public:
+
+	/// ؽ̹Ƭλ
+	static FragmentCache& instance();
+
+	/// 캯
+	FragmentCache( const size_t capacity = 16777216 );
+
+	/// 
+	virtual ~FragmentCache();
+
+	/// ȡƬ
+	bool get( const string &key, string &data );
+	/// Ƭ
+	void set( const string &key, const string &data, const int ttl = 0 );
+
+	/// û
+	void set_capacity( const size_t capacity );
+	/// ɾָƬ
+	void remove( const string &key );
+	/// Ƭλ
+	void clear();
+	/// ػƬ
+	size_t size();
+	/// ػƬܳ
+	size_t bytes();
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// ɾδʹõƬֱ
+	void shrink();
+
+	/// ֹÿ캯
+	FragmentCache( FragmentCache &copy );
+	/// ֹÿֵ
+	FragmentCache& operator = ( const FragmentCache& copy );
+
+	typedef struct {					// Ƭλṹ
+		string key;						// 
+		string data;					// Ƭ
+		time_t expires;					// ʱ,Ϊ0
+	} cache_entry;
+	typedef list<cache_entry> cache_list;
+
+	cache_list _lru;					// Ƭб,ʹõǰ
+	map<string,cache_list::iterator> _entries;	// Ƭ <,Ƭλ>
+	pthread_mutex_t _lock;				// 
+	size_t _capacity;					// ,λΪֽ
+	size_t _bytes;						// ѻƬܳ
+};
+
+/// ģ岢̳߳
+/// ѭʱʹ,̿ͬʱʹͬһ̳߳,
+/// run()ִ߳ͬ,߳Ϊ0ʱڵִ߳
+class TemplatePool {
+	public:
+
+	/// 
+	typedef void (*task_func)( void *arg );
+
+	/// ؽ̹̳߳
+	static TemplatePool& instance();
+
+	/// 캯
+	TemplatePool( const int threads = 0 );
+
+	/// 
+	virtual ~TemplatePool();
+
+	/// ߳
+	void set_threads( const int threads );
+	/// ߳
+	int threads();
+
+	/// ִ
+	void run( const task_func func, void **args, const size_t count );
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// ̺߳
+	static void* worker( void *pool );
+	/// ִһ񲢸
+	void execute();
+
+	/// ֹÿ캯
+	TemplatePool( TemplatePool &copy );
+	/// ֹÿֵ
+	TemplatePool& operator = ( const TemplatePool& copy );
+
+	typedef struct {					// ṹ
+		task_func func;					// 
+		void *arg;						// 
+		size_t *pending;				// δ
+	} pool_task;
+
+	list<pool_task> _tasks;				// ִб
+	vector<pthread_t> _threads;			// ߳б
+	pthread_mutex_t _lock;				// 
+	pthread_cond_t _wake;				// Ҫֹͣ
+	pthread_cond_t _done;				// 
+	int _size;							// ߳
+	bool _stop;							// ߳ǷҪֹͣ
+};
+
+/// ģȽ
+/// ģʽıȽϹͬ,TemplateCodegenɵĴʹ
+int tmpl_compare( const string &lhs, const string &rhs );
+/// ģǷ
+/// \param val ʽֵ
+/// \retval true ֵΪ""ҲΪ"0"
+/// \retval false ֵΪ"""0"
+inline bool tmpl_istrue( const string &val ) {
+	return !( val.empty() || (val.length()==1 && val[0]=='0') );
+}
+
+/// ģC++
+/// ģתΪC++ͷļ,ģıΪַ鳣,ѭΪC++,
+/// ģΪɵĽṹ,ѭΪṹеvector,ʱٽģָ,
+/// ڷҳ,μtmpl2cpp
+class TemplateCodegen {
+	public:
+
+	/// 캯
+	/// \param code ģ
+	TemplateCodegen( const CompiledTemplate &code ):
+	_code(code), _temps(0), _date(false), _time(false)
+	{};
+
+	/// 
+	virtual ~TemplateCodegen(){};
+
+	/// C++
+	bool generate( ostream &output, const string &name, const string &source = "" );
+
+	/// ɴ¼
+	/// \return ɴ¼ <λ,Ϣ>
+	inline const multimap<int,string>& errors() const {
+		return _errlog;
+	}
+
+	////////////////////////////////////////////////////////////////////////////
+	private:
+
+	/// ָд
+	void block( ostream &output, const size_t begin, const size_t end, const int indent );
+	/// رʽ
+	string value( const int val, const int line, bool &stable );
+	/// ʽ
+	string cond( const int cond, const int line );
+	/// ѭʶ
+	string loop( const int val, const int line );
+	/// ѭݱʶ
+	string loop_ident( const int slot );
+	/// ѭ
+	string cursor( const string &id );
+	/// ѭֶαʶ
+	string field( const int loop, const int slot );
+	/// ΨһC++ʶ
+	string ident( const string &scope, const string &name, const string &kind = "" );
+	/// ɴ¼
+	void error_log( const int line, const string &error );
+
+	/// ֹÿ캯
+	TemplateCodegen( TemplateCodegen &copy );
+	/// ֹÿֵ
+	TemplateCodegen& operator = ( const TemplateCodegen& copy );
+
+	const CompiledTemplate &_code;		// ģ
+	map<string,string> _idents;			// ʶб <Χ,ʶ>
+	map<string,bool> _used;				// ʹõıʶ <Χʶ,true>
+	vector<int> _vars;					// Ʊ,˳
+	vector<int> _loops;					// ѭƱ,˳
+	map< int,vector<int> > _fields;		// ѭֶ <ѭƱ,ֶƱб>
+	vector<int> _stack;					// ǰѭǶ,ѭƱ
+	vector<string> _literals;			// ģı
+	map<string,bool> _cursors;			// ʹõѭ <ѭʶ,true>
+	int _temps;							// ʱ
+	bool _date;							// Ƿʹ%DATE
+	bool _time;							// Ƿʹ%TIME
+	multimap<int,string> _errlog;		// ɴ¼ <λ,Ϣ>
+};
+
 /// ֧ѭűHTMLģ崦
+/// ģݱRenderContext,ģCompiledTemplateڶTemplate֮乲
 /// <a href="wa_template.html">ʹ˵ĵ򵥷</a>
-class Template {
+class Template : public RenderContext {
 	public:
 	
 	/// ĬϹ캯
@@ -62,32 +1348,27 @@ class Template {
 		return this->load( tmpl_dir + "/" + tmpl_file );
 	}
 	
+	/// ģ建ȡHTMLģļ
+	bool load_cached( const string &tmpl_file );
+	
 	/// HTMLģ
 	void tmpl( const string &tmpl );
 
-	/// 滻
-	void set( const string &name, const string &value );
-	/// 滻
-	/// \param name ģ
-	/// \param value 滻ֵ
-	inline void set( const string &name, const long value ) {
-		this->set( name, itos(value) );
+	/// رģ
+	/// \return ģ,δȡģʱΪָ
+	inline const CompiledTemplatePtr& compiled() const {
+		return _code;
 	}
-	
-	/// ½ѭ
-	void def_loop( const string &loop, const char* field_0, ... );
-	/// һݵѭ
-	void append_row( const string &loop, const char* value_0, ... );
-	/// һָʽݵѭ
-	void append_format( const string &loop, const char* format, ... );
-	
-	/// 滻
-	void clear_set();
 
+	/// HTML
+	void output( TemplateSink &output, const output_mode mode = TMPL_OUTPUT_RELEASE );
 	/// HTMLַ
 	string html();
 	/// HTMLstdout
 	void print( const output_mode mode = TMPL_OUTPUT_RELEASE );
+	/// ֶHTMLstdout
+	void stream( const output_mode mode = TMPL_OUTPUT_RELEASE, const size_t flush_size = 8192,
+		const bool chunked = false );
 	/// HTMLļ
 	bool print( const string &file, const output_mode mode = TMPL_OUTPUT_RELEASE,
 		const mode_t permission = S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH );
@@ -95,72 +1376,14 @@ class Template {
 	////////////////////////////////////////////////////////////////////////////
 	private:
 	
-	/// ȡָλõģűͼʽ
-	int parse_script( const string &tmpl, const size_t pos,
-		string &exp, int &type );
-
-	/// ʽֵ
-	string exp_value( const string &expression );
-
-	/// ģ
-	void parse( const string &tmpl, ostream &output );
-	
-	/// ʽǷ
-	bool compare( const string &exp );
-	
-	/// Ƿ
-	bool check_if( const string &exp );
-
-	/// ģ
-	size_t parse_if( const string &tmpl, ostream &output, 
-		const bool parent_state, const string &parsed_exp,
-		const int parsed_length );
-
-	/// ֶλ
-	int field_pos( const string &loop, const string &field );
-
-	/// ѭǷЧ
-	bool check_loop( const string &loopname );
-	
-	/// ѭָλֶεֵ
-	string loop_value( const string &field );
-
-	/// ѭģ
-	size_t parse_loop( const string &tmpl, ostream &output, 
-		const bool parent_state, const string &parsed_exp,
-		const int parsed_length );
-							
-	/// ģ¼
-	void error_log( const size_t lines, const string &error );
+	/// ִģָ
+	void render( TemplateSink &output );
 	/// ģ¼
 	void parse_log( ostream &output );
 
-	// ݶ
-	typedef vector<string> strings;		// ַб
-	typedef struct {					// ѭģýṹ
-		int cols;						// ѭֶ
-		int rows;						// ѭ
-		int cursor;						// ǰλ
-		strings fields;					// ѭֶζб
-		map<string,int> fieldspos;		// ѭֶλ,for speed
-		vector<strings> datas;			// ѭ
-	} tmpl_loop;
-
-	// ģ
-	String _tmpl;						// HTMLģ
-	map<string,string> _sets;			// 滻б <ģ,ģֵ>
-	map<string,tmpl_loop> _loops;		// ѭ滻б <ѭ,ѭģýṹ>
-	
-	// 
-	string _loop;						// ǰѭ
-	int _cursor;						// ǰѭλ
-	int _lines;							// Ѵģ
-
+	CompiledTemplatePtr _code;			// HTMLģ
 	string _tmplfile;					// HTMLģļ
-	char _date[15];						// ǰ
-	char _time[15];						// ǰʱ
 	output_mode _debug;					// ģʽ
-	multimap<int,string> _errlog;		// ¼ <λ,Ϣ>
 };
 
 // ģ﷨ʽ
@@ -176,6 +1399,11 @@ const char TMPL_DATE[]		= "%DATE";	const int TMPL_DATE_LEN 	= strlen(TMPL_DATE);
 const char TMPL_TIME[]		= "%TIME";	const int TMPL_TIME_LEN 	= strlen(TMPL_TIME);
 const char TMPL_SPACE[]		= "%SPACE";	const int TMPL_SPACE_LEN	= strlen(TMPL_SPACE);
 const char TMPL_BLANK[]		= "%BLANK";	const int TMPL_BLANK_LEN 	= strlen(TMPL_BLANK);
+const char TMPL_FLUSH[]		= "#FLUSH";	const int TMPL_FLUSH_LEN 	= strlen(TMPL_FLUSH);
+const char TMPL_CACHE[]		= "#CACHE";	const int TMPL_CACHE_LEN 	= strlen(TMPL_CACHE);
+const char TMPL_ENDCACHE[]	= "#ENDCACHE";const int TMPL_ENDCACHE_LEN = strlen(TMPL_ENDCACHE);
+const char TMPL_INCLUDE[]	= "#INCLUDE";const int TMPL_INCLUDE_LEN = strlen(TMPL_INCLUDE);
+const int TMPL_INCLUDE_MAX	= 256;		// ÿģȡ{{#INCLUDE}}ļ
                                         
 const char TMPL_LOOP[]		= "#FOR";	const int TMPL_LOOP_LEN 	= strlen(TMPL_LOOP);
 const char TMPL_ENDLOOP[]	= "#ENDFOR";const int TMPL_ENDLOOP_LEN = strlen(TMPL_ENDLOOP);
@@ -219,7 +1447,12 @@ enum tmpl_scripttype {
 	TMPL_S_TIME,
 	TMPL_S_SPACE,
 	TMPL_S_BLANK,
-	TMPL_S_UNKNOWN
+	TMPL_S_FLUSH,
+	TMPL_S_CACHE,
+	TMPL_S_ENDCACHE,
+	TMPL_S_INCLUDE,
+	TMPL_S_UNKNOWN,
+	TMPL_S_TEXT
 };
 
 // ߼
@@ -229,6 +1462,14 @@ enum tmpl_logictype {
 	TMPL_L_OR
 };
 
+// 滻ֵ
+enum tmpl_vartype {
+	TMPL_V_TEXT,
+	TMPL_V_INT,
+	TMPL_V_REAL,
+	TMPL_V_BOOL
+};
+
 // Ƚ
 enum tmpl_cmptype {
 	TMPL_C_EQ,
@@ -336,7 +336,7 @@ string host_addr( const string &interface ) {
 	}
 	
 	static char buf[256] = {0};
-	if( inet_ntop(AF_INET,(void *)&sin->sin_addr,buf,sizeof(buf)-1) < 0 ) {
+	if( inet_ntop(AF_INET,(void *)&sin->sin_addr,buf,sizeof(buf)-1) == NULL ) {
 		close( fd );
 		return string("");
 	}
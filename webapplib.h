@@ -15,6 +15,7 @@
  * <b>ConfigFile</b> : INIʽļࣻ<br>
  * <b>FileSystem</b> : ļϵͳ⣻<br>
  * <b>Encode</b> : ַ뺯⣻<br>
+ * <b>Json</b> : JSON밴ࣻ<br>
  * <b>Utility</b> : ϵͳ빤ߺ<br>
  * ϸʹ˵ɲμοֲ help.chm<br>
  *
@@ -41,6 +42,7 @@
 #include "waUtility.h"
 #include "waTextFile.h"
 #include "waConfigFile.h"
+#include "waJson.h"
 
 // ʱʹ -D_WEBAPPLIB_NOMYSQL 򲻰 MysqlCleint ģ
 #ifndef _WEBAPPLIB_NOMYSQL